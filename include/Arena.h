@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// Monotonic allocator for the temporaries of a single message: allocating
+// is a pointer bump and everything is released at once by rewind(). The
+// memory is kept across messages, so once the arena has grown to the
+// largest message seen it does not allocate anymore.
+class Arena {
+
+public:
+    explicit Arena(size_t initialBytes = 4096) : initial(initialBytes) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        if(not blocks.empty()){
+            Block& block = blocks[current];
+            size_t start = align(block.used, alignment, block.data.get());
+            if(start + bytes <= block.size){
+                block.used = start + bytes;
+                return block.data.get() + start;
+            }
+            // Blocks left over by a previous message
+            while(current + 1 < blocks.size()){
+                Block& next = blocks[++current];
+                next.used = 0;
+                start = align(0, alignment, next.data.get());
+                if(start + bytes <= next.size){
+                    next.used = start + bytes;
+                    return next.data.get() + start;
+                }
+            }
+        }
+        size_t size = std::max(bytes + alignment, blocks.empty() ? initial : blocks.back().size * 2);
+        blocks.push_back(Block{std::unique_ptr<unsigned char[]>(new unsigned char[size]), size, 0});
+        current = blocks.size() - 1;
+        Block& block = blocks[current];
+        size_t start = align(0, alignment, block.data.get());
+        block.used = start + bytes;
+        return block.data.get() + start;
+    }
+
+    template<typename T>
+    T* allocate(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Release everything allocated so far. A message that needed more than
+    // one block is followed by a single block large enough for all of them.
+    void rewind() {
+        if(blocks.size() > 1 && current > 0){
+            size_t total = 0;
+            for(const auto& block : blocks){
+                total += block.size;
+            }
+            blocks.clear();
+            blocks.push_back(Block{std::unique_ptr<unsigned char[]>(new unsigned char[total]), total, 0});
+        }
+        current = 0;
+        if(not blocks.empty()){
+            blocks[0].used = 0;
+        }
+    }
+
+    size_t capacity() const {
+        size_t total = 0;
+        for(const auto& block : blocks){
+            total += block.size;
+        }
+        return total;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+        size_t used;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t initial;
+
+    static size_t align(size_t offset, size_t alignment, const unsigned char* base) {
+        uintptr_t address = reinterpret_cast<uintptr_t>(base) + offset;
+        return offset + ((alignment - address % alignment) % alignment);
+    }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Base64 codec (standard alphabet, '=' padding) with SSSE3 and AVX2 kernels
+// selected at runtime and a table-driven scalar fallback.
+class Base64 {
+public:
+    // Upper bound of the bytes produced by decoding 'length' characters
+    static size_t decodedLength(size_t length) { return ((length + 3) >> 2) * 3; }
+    // Exact number of characters produced by encoding 'length' bytes
+    static size_t encodedLength(size_t length) { return ((length + 2) / 3) << 2; }
+
+    // Decode 'src' into the caller provided buffer 'dst', which must hold at
+    // least decodedLength(length) bytes. Decoding stops at the first padding
+    // or non base64 character; returns the number of bytes written.
+    static size_t decode(const char* src, size_t length, unsigned char* dst);
+    static size_t decode(const std::string& src, unsigned char* dst) {
+        return decode(src.data(), src.size(), dst);
+    }
+
+    // Encode 'length' bytes into 'dst', which must hold encodedLength(length)
+    // characters (no terminator is written)
+    static void encode(const unsigned char* src, size_t length, char* dst);
+    static std::string encode(const unsigned char* src, size_t length) {
+        std::string encoded(encodedLength(length), '\0');
+        encode(src, length, &encoded[0]);
+        return encoded;
+    }
+
+    // Name of the kernel selected for this CPU ("avx2", "ssse3" or "scalar")
+    static const char* implementation();
+};
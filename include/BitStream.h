@@ -6,15 +6,16 @@
 #include <algorithm>
 #include <sstream>
 #include <stdexcept>
-
+#include "BitView.h"
+#include "Base64.h"
 
 class BitStream {
 
 public:
     BitStream(const std::string& base64_str, const std::string& type_) : type(type_){
         offset = 0;
-        data = nullptr;
-        lengthInBytes = base64_decode(base64_str, data);
+        data = static_cast<unsigned char*>(calloc(Base64::decodedLength(base64_str.size()) + 1, sizeof(unsigned char)));
+        lengthInBytes = data != nullptr ? Base64::decode(base64_str, data) : 0;
         length = lengthInBytes * 8;
 
         if(data==nullptr){
@@ -29,7 +30,9 @@ public:
         }
     }
 
-    BitStream(const unsigned char* src, size_t length_, const std::string& type_) : type(type_){
+    // With 'copy' set to false the stream borrows 'src' instead of copying it:
+    // the buffer must then outlive the stream and it is never modified or freed
+    BitStream(const unsigned char* src, size_t length_, const std::string& type_, bool copy = true) : type(type_){
         if(length_==0){
             std::cerr << "Passed length is zero" << std::endl;
             data = nullptr;
@@ -39,6 +42,11 @@ public:
         length = length_;
         lengthInBytes = (length + 7) >> 3;  // Allocate at least 1 byte
 
+        if(not copy){
+            data = const_cast<unsigned char*>(src);
+            owned = false;
+            return;
+        }
         data = static_cast<unsigned char*>(calloc(lengthInBytes, sizeof(unsigned char)));
         if(data==nullptr){
             std::cerr << "ATTENZIONE errore nell'allocazione dello spazio" << std::endl;
@@ -47,7 +55,7 @@ public:
     }
 
     ~BitStream() {
-        if(data != nullptr){
+        if(data != nullptr && owned){
             free(data);            
             data = nullptr;
         }
@@ -111,16 +119,40 @@ public:
         return bt;
     }    
 
+    // Zero-copy counterparts of read()/consume(): the returned view points
+    // into this stream, so it is valid only while the stream is alive
+    BitView view(int length_) const {
+        if(offset + length_ > length){
+            throw std::length_error("Trying to access more bits than provided: current offset is <" + 
+                                    std::to_string(offset) + ">, bits to be consumed are <" +
+                                    std::to_string(length_) + ">, total amount of bits is <" + std::to_string(length) + ">");
+        }
+        return BitView(data, offset, length_, lengthInBytes);
+    }
+
+    BitView consumeView(int length_) {
+        BitView bv = view(length_);
+        offset += length_;
+        return bv;
+    }
+
+    // Consume the bits up to (not including) the next 'delimiter' byte
+    BitView consumeViewUntill(int delimiter){
+        size_t found = BitView(data, offset, length - offset, lengthInBytes).findByte(0, static_cast<unsigned char>(delimiter));
+        if(found == BitView::npos){
+            throw std::length_error("Delimiter <" + std::to_string(delimiter) + "> not found: current offset is <" + 
+                                    std::to_string(offset) + ">, total amount of bits is <" + std::to_string(length) + ">");
+        }
+        return consumeView(found);
+    }
+
     BitStream consumeUntill(int delimiter){
         BitStream bt;
-        unsigned int offset_ = offset;
-        while(readFrom(8, offset_).to_int()!=delimiter && offset_<length){
-            offset_++;
-        }
-        if(offset_>=length){
+        size_t found = BitView(data, offset, length - offset, lengthInBytes).findByte(0, static_cast<unsigned char>(delimiter));
+        if(found == BitView::npos || found == 0){
             return bt;
         }
-        return consume(offset_-offset);
+        return consume(found);
     }
 
 
@@ -154,6 +186,7 @@ public:
     BitStream* append(BitStream* b){
         if(data==nullptr || length==0){
             data = static_cast<unsigned char*>(calloc(lengthInBytes, sizeof(unsigned char)));
+            owned = true;
             if(data==nullptr){
                 std::cerr << "ATTENZIONE errore nell'allocazione dello spazio" << std::endl;
             }
@@ -220,10 +253,11 @@ public:
             memcpy(result + lengthInBytes, shifted, b->lengthInBytes);
         }
 
-        if(data!=nullptr){
+        if(data!=nullptr && owned){
            free(data);
         }
         data = result;
+        owned = true;
         length = totalLength;
         lengthInBytes = totalLengthInBytes;
         offset = 0;
@@ -241,19 +275,17 @@ public:
         return this;
     }
 
-    int to_int_bcd(size_t bits = 4){
-        if(bits%4){ std::cout << "Unsupported number of bits for BCD encoding: " << bits << std::endl; }
-        int8_t value[8];
-        unsigned int mult = bits >> 2;
-        std::memcpy(value, data, mult*sizeof(int8_t));
-        int result = 0;
-        unsigned short mask_low  = 0b00001111;
-        unsigned short mask_high = 0b11110000;
-        for (int i = mult-1; i >= 0; i--) {
-            if(i%2){ result += (value[i] & mask_low) * (i*10); }
-            else { result += ((value[i] & mask_high) >> 4) * (i*10); }
+    // Reuse the stream for a new message borrowing 'src' (see the borrowing
+    // constructor): the buffer must outlive the use of the stream
+    void borrow(const unsigned char* src, size_t length_, size_t lengthInBytes_) {
+        if(data != nullptr && owned){
+            free(data);
         }
-        return result;
+        data = const_cast<unsigned char*>(src);
+        owned = false;
+        offset = 0;
+        length = length_;
+        lengthInBytes = lengthInBytes_;
     }
 
     int to_int(size_t bits = 8){
@@ -277,7 +309,7 @@ public:
     int to_int8(){ return to_int(8); }
     int to_int16(){ return to_int(16); }
     int to_int32(){ return to_int(32); }
-    int to_int64(){ return to_int(64); }
+    int64_t to_int64(){ return readI64(0, length < 64 ? length : 64); }
 
     unsigned int to_uint(size_t bits = 8){
         uint8_t value[8];
@@ -297,7 +329,15 @@ public:
     unsigned int to_uint8(){ return to_uint(8); }
     unsigned int to_uint16(){ return to_uint(16); }
     unsigned int to_uint32(){ return to_uint(32); }
-    unsigned int to_uint64(){ return to_uint(64); }
+    uint64_t to_uint64(){ return readU64(0, length < 64 ? length : 64); }
+
+    // Typed readers working on the whole stream (the offset is absolute)
+    uint64_t readU64(size_t offset_, size_t bits) const {
+        return BitView(data, 0, length, lengthInBytes).readU64(offset_, bits);
+    }
+    int64_t readI64(size_t offset_, size_t bits) const {
+        return BitView(data, 0, length, lengthInBytes).readI64(offset_, bits);
+    }
 
     std::string to_string(){
         return std::string(reinterpret_cast<char*>(data), lengthInBytes);
@@ -339,10 +379,10 @@ public:
         return false;
     }
 
-    const unsigned int getOffset(){return offset;}
+    size_t getOffset(){return offset;}
     const unsigned char* getData(){return data;}
-    const unsigned int getLength(){return length;}
-    const unsigned int getLengthInBytes(){return lengthInBytes;}
+    size_t getLength(){return length;}
+    size_t getLengthInBytes(){return lengthInBytes;}
 
     const std::string getType() const {return type;}
 
@@ -355,7 +395,7 @@ public:
             unsigned char mask = ((1 << alignment) - 1);
             clearData[lengthInBytes-1] = data[lengthInBytes-1] & ~mask;
         }
-        return base64_encode(clearData, lengthInBytes);
+        return Base64::encode(clearData, lengthInBytes);
     }
 
     const std::string toString() {
@@ -408,9 +448,10 @@ public:
 private:
     std::string type;
     unsigned char* data;
-    unsigned int offset;
-    unsigned int length;
-    unsigned int lengthInBytes;
+    size_t offset;
+    size_t length;
+    size_t lengthInBytes;
+    bool owned = true;
 
 
     void setBitStream(const unsigned char* src, size_t length_, const std::string& type_){
@@ -424,10 +465,11 @@ private:
         type = type_;
         lengthInBytes = (length + 7) >> 3; 
 
-        if(data != nullptr){
+        if(data != nullptr && owned){
             free(data);            
-            data = nullptr;
         }
+        data = nullptr;
+        owned = true;
         data = static_cast<unsigned char*>(calloc(lengthInBytes, sizeof(unsigned char)));
         if(data==nullptr){
             std::cerr << "ATTENZIONE errore nell'allocazione dello spazio" << std::endl;
@@ -487,95 +529,4 @@ private:
         }
         return bt;
     }
-    static constexpr const char base64_chars[64] = {
-        'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
-        'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
-        'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
-        'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
-        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'
-    };
-
-    static inline bool is_base64(unsigned char c) {
-        return (isalnum(c) || (c == '+') || (c == '/'));
-    }
-
-    static size_t base64_decode(const std::string& encoded_string, unsigned char*& decoded_data) {
-        size_t in_len = encoded_string.size();
-        size_t i = 0;
-        size_t j = 0;
-        size_t in_ = 0;
-        unsigned char char_array_4[4], char_array_3[3];
-        int k = 0;
-
-        if(decoded_data!=nullptr){
-            free(decoded_data);
-        }
-        decoded_data = reinterpret_cast<unsigned char*>(calloc((in_len * 3) / 4 + 1, sizeof(unsigned char)));
-
-        while (in_len-- && (encoded_string[in_] != '=') && (isalnum(encoded_string[in_]) || (encoded_string[in_] == '+') || (encoded_string[in_] == '/'))) {
-            char_array_4[i++] = encoded_string[in_]; in_++;
-            if (i == 4) {
-                for (i = 0; i < 4; i++)
-                    char_array_4[i] = std::find(BitStream::base64_chars, BitStream::base64_chars + 64, char_array_4[i]) - BitStream::base64_chars;
-
-                char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-                char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-                char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-
-                for (i = 0; i < 3; i++)
-                    decoded_data[k++] = char_array_3[i];
-                i = 0;
-            }
-        }
-
-        if (i) {
-            for (j = i; j < 4; j++)
-                char_array_4[j] = 0;
-
-            for (j = 0; j < 4; j++)
-                char_array_4[j] = std::find(BitStream::base64_chars, BitStream::base64_chars + 64, char_array_4[j]) - BitStream::base64_chars;
-
-            char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-            char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-            char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-
-            for (j = 0; (j < i - 1); j++)
-                decoded_data[k++] = char_array_3[j];
-        }
-        return static_cast<size_t>(k);
-    }
-
-    static const std::string base64_encode(unsigned char* data, size_t length) {
-        std::string encoded_string;
-        size_t length_ = length;
-        unsigned char* data_ = data;
-
-        while (length_>0) {
-            unsigned char input_array[3] = {0};
-            int padding = 0;
-
-            input_array[0] = *(data_++);
-            length_--;
-            if (length_) {
-                input_array[1] = *(data_++);
-                length_--;
-                padding++;
-            }
-            if (length_) {
-                input_array[2] = *(data_++);
-                length_--;
-                padding++;
-            }
-
-            encoded_string += base64_chars[(input_array[0] & 0xfc) >> 2];
-            encoded_string += base64_chars[((input_array[0] & 0x03) << 4) | ((input_array[1] & 0xf0) >> 4)];
-            encoded_string += padding ? base64_chars[((input_array[1] & 0x0f) << 2) | ((input_array[2] & 0xc0) >> 6)] : '=';
-            encoded_string += padding ? base64_chars[input_array[2] & 0x3f] : '=';
-        }
-
-        return encoded_string;
-    }
 };
-
-
-
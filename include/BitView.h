@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+
+
+// Non-owning window over a bit buffer (pointer + bit offset + bit length).
+// Values are read straight from the parent buffer, so the parent must outlive
+// the view. The bits are interpreted MSB first, as in BitStream.
+class BitView {
+
+public:
+    BitView() : data(nullptr), offset(0), length(0), limit(0) {}
+
+    BitView(const unsigned char* data_, size_t offset_, size_t length_) :
+        data(data_), offset(offset_), length(length_), limit((offset_ + length_ + 7) >> 3) {}
+
+    // 'limit_' is the size in bytes of the parent buffer: when it is known the
+    // readers can load whole words even if the field ends before a word boundary
+    BitView(const unsigned char* data_, size_t offset_, size_t length_, size_t limit_) :
+        data(data_), offset(offset_), length(length_), limit(limit_) {}
+
+    BitView subView(size_t offset_, size_t length_) const {
+        if(offset_ + length_ > length){
+            throw std::length_error("Trying to access more bits than provided: current offset is <" +
+                                    std::to_string(offset_) + ">, bits to be consumed are <" +
+                                    std::to_string(length_) + ">, total amount of bits is <" + std::to_string(length) + ">");
+        }
+        return BitView(data, offset + offset_, length_, limit);
+    }
+
+    // Read 'bits' (up to 64) bits starting 'offset_' bits into the view and
+    // return them right aligned. A single unaligned big-endian word load covers
+    // any field that fits in 64 bits after the in-byte shift; only fields wider
+    // than 56 bits that start mid-byte need a ninth byte.
+    uint64_t readU64(size_t offset_, size_t bits) const {
+        if(bits == 0){ return 0; }
+        if(bits > 64){
+            throw std::length_error("Trying to read <" + std::to_string(bits) + "> bits into a 64 bit integer");
+        }
+        size_t from = offset + offset_;
+        size_t byte = from >> 3;
+        unsigned int shift = from & 7;
+        uint64_t word = load64(byte) << shift;
+        if(shift + bits > 64){
+            word |= static_cast<uint64_t>(data[byte + 8]) >> (8 - shift);
+        }
+        return word >> (64 - bits);
+    }
+
+    // As readU64() but the value is sign extended from bit 'bits'-1
+    int64_t readI64(size_t offset_, size_t bits) const {
+        if(bits == 0){ return 0; }
+        return static_cast<int64_t>(readU64(offset_, bits) << (64 - bits)) >> (64 - bits);
+    }
+
+    // Bit offset (relative to the view) of the first occurrence of 'byte' at
+    // from, from + 8, from + 16, ... or npos when it does not occur. Delimited
+    // fields are whole bytes, so the search steps by bytes from the cursor.
+    // When the cursor is byte aligned the search is a memchr() over the parent
+    // buffer; a bit-unaligned cursor falls back to scanning 64-bit words
+    // extracted with readU64() and tested for the byte with SWAR arithmetic.
+    size_t findByte(size_t from, unsigned char byte) const {
+        if(((offset + from) % 8) == 0){
+            size_t start = (offset + from) >> 3;
+            size_t count = (length - std::min<size_t>(from, length)) >> 3;
+            const void* found = count ? std::memchr(data + start, byte, count) : nullptr;
+            if(found == nullptr){ return npos; }
+            return (static_cast<const unsigned char*>(found) - data) * 8 - offset;
+        }
+        const uint64_t ones = 0x0101010101010101ULL;
+        const uint64_t lows = 0x7f7f7f7f7f7f7f7fULL;
+        size_t bit = from;
+        for(; bit + 64 <= length; bit += 64){
+            uint64_t word = readU64(bit, 64) ^ (ones * byte);
+            // High bit set in every byte of 'word' that is zero (no carries between bytes)
+            uint64_t zeros = ~(((word & lows) + lows) | word | lows);
+            if(zeros){
+                return bit + __builtin_clzll(zeros);
+            }
+        }
+        for(; bit + 8 <= length; bit += 8){
+            if(readU64(bit, 8) == byte){ return bit; }
+        }
+        return npos;
+    }
+
+    // Copy the bits into 'dst' right aligned, exactly as BitStream::read() lays
+    // them out: the first byte holds the most significant (length % 8) bits.
+    void copyTo(unsigned char* dst) const {
+        size_t lengthInBytes = getLengthInBytes();
+        if(lengthInBytes == 0){ return; }
+        if((offset % 8) == 0 && (length % 8) == 0){
+            memcpy(dst, data + (offset >> 3), lengthInBytes);
+            return;
+        }
+        size_t head = length % 8 ? length % 8 : 8;
+        dst[0] = static_cast<unsigned char>(readU64(0, head));
+        for(size_t i = 1, bit = head; i < lengthInBytes; i++, bit += 8){
+            dst[i] = static_cast<unsigned char>(readU64(bit, 8));
+        }
+    }
+
+    // Copy the bits into 'dst' from its first bit on, the last byte padded
+    // with zeros: the view then starts on a byte boundary
+    void copyAlignedTo(unsigned char* dst) const {
+        for(size_t i = 0, bit = 0; bit < length; i++, bit += 8){
+            unsigned int bits = length - bit < 8 ? static_cast<unsigned int>(length - bit) : 8;
+            dst[i] = static_cast<unsigned char>(readU64(bit, bits) << (8 - bits));
+        }
+    }
+
+    std::string to_string() const {
+        size_t lengthInBytes = getLengthInBytes();
+        if(lengthInBytes == 0){ return ""; }
+        if((offset % 8) == 0 && (length % 8) == 0){
+            return std::string(reinterpret_cast<const char*>(data + (offset >> 3)), lengthInBytes);
+        }
+        std::string result(lengthInBytes, '\0');
+        copyTo(reinterpret_cast<unsigned char*>(&result[0]));
+        return result;
+    }
+
+    double to_double(size_t bits = 32) const {
+        switch(bits){
+            case 32:
+                {
+                    uint32_t raw = static_cast<uint32_t>(readU64(0, 32));
+                    float value;
+                    std::memcpy(&value, &raw, sizeof(value));
+                    return value;
+                }
+            case 64:
+                {
+                    uint64_t raw = readU64(0, 64);
+                    double value;
+                    std::memcpy(&value, &raw, sizeof(value));
+                    return value;
+                }
+            default:
+                throw std::invalid_argument("Unsupported number of bits for decimal: " + std::to_string(bits));
+        }
+    }
+
+    bool to_boolean() const {
+        for(size_t bit = 0; bit < length; bit += 64){
+            size_t chunk = length - bit < 64 ? length - bit : 64;
+            if(readU64(bit, chunk)){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const unsigned char* getData() const {return data;}
+    size_t getOffset() const {return offset;}
+    size_t getLength() const {return length;}
+    size_t getLengthInBytes() const {return (length + 7) >> 3;}
+    bool empty() const {return length == 0;}
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    const std::string toString() const {
+        std::ostringstream oss;
+        for(size_t bit = 0; bit < length; bit++){
+            oss << readU64(bit, 1);
+        }
+        oss << " - " << length << " bit(s)";
+        return oss.str();
+    }
+
+private:
+    const unsigned char* data;
+    size_t offset;
+    size_t length;
+    size_t limit;
+
+    // Big-endian 64-bit load of the bytes starting at 'byte'. Near the end of
+    // the parent buffer the missing bytes are read as zero.
+    uint64_t load64(size_t byte) const {
+        uint64_t word = 0;
+        if(byte + 8 <= limit){
+            std::memcpy(&word, data + byte, 8);
+        } else if(byte < limit){
+            std::memcpy(&word, data + byte, limit - byte);
+        }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        return word;
+    }
+};
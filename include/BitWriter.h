@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstring>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <vector>
+#include "BitView.h"
+#include "Base64.h"
+
+
+// Append-only bit buffer used by the encode path. Bits are written MSB first
+// into a single byte vector that grows geometrically, so building a message
+// is one linear pass whatever the number of fields.
+class BitWriter {
+
+public:
+    BitWriter() {}
+
+    // 'bitLengthHint' is the expected size of the message (see
+    // Schema::bitLengthHint): reserving it up front avoids any regrowth
+    explicit BitWriter(size_t bitLengthHint) {
+        reserve(bitLengthHint);
+    }
+
+    void reserve(size_t bits) {
+        buffer.reserve(((bits + 7) >> 3) + 8);
+    }
+
+    // Drop the content but keep the capacity
+    void clear() {
+        buffer.clear();
+        size = 0;
+        pending = 0;
+        pendingBits = 0;
+    }
+
+    // Append the 'bits' (up to 64) least significant bits of 'value'
+    void writeBits(uint64_t value, unsigned int bits) {
+        if(bits == 0){ return; }
+        if(bits > 56){
+            // Keep pending bits + new bits within a single 64-bit accumulator
+            writeBits(value >> 32, bits - 32);
+            bits = 32;
+        }
+        value &= bits == 64 ? ~0ULL : ((1ULL << bits) - 1);
+        uint64_t accumulator = (pending << bits) | value;
+        unsigned int total = pendingBits + bits;
+        unsigned int bytes = total >> 3;
+        pendingBits = total & 7;
+        pending = accumulator & ((1u << pendingBits) - 1);
+        if(bytes){
+            // Store all the completed bytes with a single big-endian word write
+            uint64_t word = (accumulator >> pendingBits) << (64 - 8 * bytes);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            word = __builtin_bswap64(word);
+#endif
+            ensureCapacity(size + 9);
+            std::memcpy(buffer.data() + size, &word, 8);
+            size += bytes;
+        }
+        ensureCapacity(size + 1);
+        buffer[size] = pendingBits ? static_cast<unsigned char>(pending << (8 - pendingBits)) : 0;
+    }
+
+    // Append all the bits of 'view'
+    void writeView(const BitView& view) {
+        size_t bits = view.getLength();
+        if(pendingBits == 0 && (view.getOffset() % 8) == 0 && (bits % 8) == 0){
+            writeBytes(view.getData() + (view.getOffset() >> 3), bits >> 3);
+            return;
+        }
+        size_t bit = 0;
+        for(; bit + 56 <= bits; bit += 56){
+            writeBits(view.readU64(bit, 56), 56);
+        }
+        writeBits(view.readU64(bit, bits - bit), bits - bit);
+    }
+
+    // Append 'count' whole bytes
+    void writeBytes(const unsigned char* src, size_t count) {
+        if(pendingBits){
+            for(size_t i = 0; i < count; i++){ writeBits(src[i], 8); }
+            return;
+        }
+        ensureCapacity(size + count + 1);
+        std::memcpy(buffer.data() + size, src, count);
+        size += count;
+        buffer[size] = 0;
+    }
+
+    // Append 'bits' zero bits
+    void writeZeros(size_t bits) {
+        for(; bits > 56; bits -= 56){ writeBits(0, 56); }
+        writeBits(0, bits);
+    }
+
+    const unsigned char* getData() const {return buffer.data();}
+    size_t getLength() const {return size * 8 + pendingBits;}
+    size_t getLengthInBytes() const {return size + (pendingBits ? 1 : 0);}
+    BitView toView() const {return BitView(buffer.data(), 0, getLength(), getLengthInBytes());}
+
+    // Unused trailing bits of the last byte are always zero
+    std::string toBase64() const {
+        return Base64::encode(buffer.data(), getLengthInBytes());
+    }
+
+    const std::string toString() const {
+        return toView().toString();
+    }
+
+private:
+    std::vector<unsigned char> buffer;
+    size_t size = 0;            // completed bytes
+    uint64_t pending = 0;       // bits of the last, incomplete byte (right aligned)
+    unsigned int pendingBits = 0;
+
+    void ensureCapacity(size_t bytes) {
+        if(buffer.size() < bytes){
+            if(buffer.capacity() < bytes){
+                buffer.reserve(std::max(bytes, buffer.capacity() * 2));
+            }
+            buffer.resize(buffer.capacity());
+        }
+    }
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include "JsonWriter.h"
+
+
+// Streaming CBOR (RFC 8949) serializer with the interface of JsonWriter, so
+// that the Engine writes either one the same way. Containers are written
+// with indefinite length, closed by a break byte, so nothing has to be
+// patched when they end; object keys are pre-rendered by renderKey(). The
+// content is the one of the JSON output: integers take the shortest head,
+// decimals are written as single precision when that is exact.
+class CborWriter {
+
+public:
+    void clear() {
+        buffer.clear();
+    }
+
+    void reserve(size_t bytes) {
+        buffer.reserve(bytes);
+    }
+
+    void beginObject() {buffer += static_cast<char>(0xbf);}
+    void endObject() {buffer += static_cast<char>(0xff);}
+    void beginArray() {buffer += static_cast<char>(0x9f);}
+    void endArray() {buffer += static_cast<char>(0xff);}
+
+    // 'key' is empty for array items
+    void member(const std::string& key) {
+        buffer += key;
+    }
+
+    void value(int64_t number) {
+        if(number >= 0){
+            head(buffer, 0, static_cast<uint64_t>(number));
+        } else {
+            head(buffer, 1, static_cast<uint64_t>(-(number + 1)));
+        }
+    }
+
+    void value(uint64_t number) {
+        head(buffer, 0, number);
+    }
+
+    void value(double number) {
+        if(not std::isfinite(number)){
+            null();
+            return;
+        }
+        if(number >= std::numeric_limits<float>::lowest() && number <= std::numeric_limits<float>::max() &&
+           static_cast<double>(static_cast<float>(number)) == number){
+            float single = static_cast<float>(number);
+            uint32_t bits;
+            std::memcpy(&bits, &single, sizeof(bits));
+            buffer += static_cast<char>(0xfa);
+            bigEndian(buffer, bits, 4);
+        } else {
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            buffer += static_cast<char>(0xfb);
+            bigEndian(buffer, bits, 8);
+        }
+    }
+
+    void value(bool boolean) {
+        buffer += static_cast<char>(boolean ? 0xf5 : 0xf4);
+    }
+
+    void value(const char* text, size_t length) {
+        JsonWriter::validateUtf8(text, length);
+        head(buffer, 3, length);
+        buffer.append(text, length);
+    }
+
+    void null() {
+        buffer += static_cast<char>(0xf6);
+    }
+
+    void replace(size_t offset, size_t length, const char* text, size_t textLength) {
+        buffer.replace(offset, length, text, textLength);
+    }
+
+    void truncate(size_t offset) {
+        buffer.resize(offset);
+    }
+
+    size_t size() const {return buffer.size();}
+    const std::string& str() const {return buffer;}
+
+    // Text string 'name', ready to be passed to member()
+    static std::string renderKey(const std::string& name) {
+        std::string key;
+        head(key, 3, name.size());
+        key += name;
+        return key;
+    }
+
+private:
+    std::string buffer;
+
+    static void bigEndian(std::string& out, uint64_t value, int bytes) {
+        for(int shift = (bytes - 1) * 8; shift >= 0; shift -= 8){
+            out += static_cast<char>((value >> shift) & 0xff);
+        }
+    }
+
+    // Major type and argument, in the shortest form
+    static void head(std::string& out, unsigned major, uint64_t argument) {
+        char type = static_cast<char>(major << 5);
+        if(argument < 24){
+            out += static_cast<char>(type | argument);
+        } else if(argument <= UINT8_MAX){
+            out += static_cast<char>(type | 24);
+            bigEndian(out, argument, 1);
+        } else if(argument <= UINT16_MAX){
+            out += static_cast<char>(type | 25);
+            bigEndian(out, argument, 2);
+        } else if(argument <= UINT32_MAX){
+            out += static_cast<char>(type | 26);
+            bigEndian(out, argument, 4);
+        } else {
+            out += static_cast<char>(type | 27);
+            bigEndian(out, argument, 8);
+        }
+    }
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include "SchemaCatalog.h"
+
+
+// Translates a loaded schema into a C++ header holding a decoder and an
+// encoder specialized for it (see GeneratedCodec): straight-line code with
+// constant bit offsets, a single bounds check per run of fixed-size fields
+// and routing inlined as a switch. Only layouts whose output structure is
+// known statically are supported: schemas with existing conditions,
+// delimited or variable-size fields, or arrays of structures are rejected
+// with std::invalid_argument.
+class Codegen {
+public:
+    static std::string generate(const Schema&);
+
+private:
+    // Last member written in the output (-1 if none), under a runtime
+    // condition when it depends on the input
+    struct Alternative {
+        std::string condition;
+        int64_t path;
+    };
+    // What is known about the decoder at a point of the generated code
+    struct DecodeState {
+        std::vector<Alternative> alternatives;
+        std::vector<bool> set;          // per register: value decoded
+        std::vector<bool> written;      // per register: value in the output
+        bool dynamic = false;           // position depends on the input
+        size_t offset = 0;              // bits after 'pos', or from the start
+        std::string key = "0";          // routing key of the last field
+        std::string item;               // index variable inside a loop
+    };
+    // Step of a lookup in the input: an object key or an array index variable
+    struct PathPart {
+        bool index;
+        std::string token;
+    };
+
+    const Schema& schema;
+    const SchemaProgram& program;
+    const FieldTable& table;
+    std::ostringstream out;
+    size_t counter = 0;         // names of the encoder variables
+    size_t emitted = 0;         // instructions generated, duplication included
+
+    explicit Codegen(const Schema&);
+    void validate();
+    void validateField(const FieldDescriptor&, bool inArray);
+
+    void emitDecode();
+    void emitBlock(uint32_t, DecodeState, int);
+    bool emitField(uint32_t, DecodeState&, int);
+    bool emitExtend(uint32_t, DecodeState&, int);
+    bool emitLoop(uint32_t, DecodeState&, int);
+    void emitRoute(const Instruction&, const DecodeState&, int);
+    void emitBoundsCheck(uint32_t, const DecodeState&, int);
+    void emitWrite(uint32_t, uint32_t, const std::string&, DecodeState&, int);
+    void emitTransition(DecodeState&, uint32_t, int);
+    void emitTransitionFrom(int64_t, uint32_t, int);
+    void emitEnd(const DecodeState&, int);
+    std::string position(const DecodeState&) const;
+
+    void emitEncode();
+    bool emitEncodeStructure(uint32_t, uint32_t, const std::vector<PathPart>&, int);
+    bool emitEncodeElement(const FieldDescriptor&, const std::vector<PathPart>&, int);
+    bool emitEncodeField(const FieldDescriptor&, const std::vector<PathPart>&, int);
+    std::string lookup(const std::vector<PathPart>&) const;
+
+    std::ostream& line(int);
+    static std::string quote(const std::string&);
+    static std::string identifier(const std::string&);
+};
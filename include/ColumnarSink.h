@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "SchemaProgram.h"
+
+
+// Results of a batch conversion laid out by column rather than by message:
+// a column per field written by the program decoded, filled by the Engine as
+// it reads the fields, and a row per message converted. The buffers of each
+// column are the ones of Apache Arrow:
+//
+//  - a validity bitmap, bit i (of byte i / 8) set when value i is not null
+//  - the values: 64 bit integers and decimals, bits for the booleans, 32 bit
+//    offsets followed by the bytes for the strings
+//  - above them, a level of list offsets (with its own validity) for every
+//    array enclosing the field, the outermost one having a slot per row
+//
+// A field missing from a message, because of a condition or a routing, is
+// null in its row; an array element that misses it gets a null value. A
+// message that cannot be converted, or is left out by the filter, gets no row.
+class ColumnarSink {
+
+public:
+    enum class Type {INT64, UINT64, FLOAT64, BOOL, UTF8};
+
+    class Bitmap {
+    public:
+        void push(bool bit) {
+            if((length & 7) == 0){ bytes.push_back(0); }
+            if(bit){ bytes.back() |= static_cast<uint8_t>(1 << (length & 7)); }
+            length++;
+        }
+        void set(size_t index, bool bit) {
+            uint8_t mask = static_cast<uint8_t>(1 << (index & 7));
+            if(bit){
+                bytes[index >> 3] |= mask;
+            } else {
+                bytes[index >> 3] &= static_cast<uint8_t>(~mask);
+            }
+        }
+        bool get(size_t index) const {return (bytes[index >> 3] >> (index & 7)) & 1;}
+        void resize(size_t bits) {
+            bytes.resize((bits + 7) >> 3);
+            length = bits;
+            if(bits & 7){ bytes.back() &= static_cast<uint8_t>((1 << (bits & 7)) - 1); }
+        }
+        void append(const Bitmap& other) {
+            for(size_t i = 0; i < other.length; i++){ push(other.get(i)); }
+        }
+        void clear() {
+            bytes.clear();
+            length = 0;
+        }
+        size_t size() const {return length;}
+        size_t count() const;       // of the bits set
+        const std::vector<uint8_t>& data() const {return bytes;}
+
+    private:
+        std::vector<uint8_t> bytes;
+        size_t length = 0;
+    };
+
+    // Offsets of the items of each slot of an array level
+    struct List {
+        std::vector<int32_t> offsets{0};
+        Bitmap validity;
+    };
+
+    struct Column {
+        std::string name;               // pointer of the field
+        Type type;
+        std::vector<uint32_t> arrays;   // nesting level of each enclosing array, outermost first
+        std::vector<List> lists;        // one per enclosing array
+        Bitmap validity;
+        std::vector<uint64_t> values;   // INT64, UINT64 and FLOAT64
+        Bitmap bits;                    // BOOL
+        std::vector<int32_t> offsets{0};    // UTF8
+        std::string text;
+
+        // Rows still being written
+        size_t row = SIZE_MAX;          // last row written
+        std::vector<uint32_t> last;     // array indices of the last value written in 'row'
+        std::vector<size_t> mark;       // sizes of the lists before 'row'
+        size_t markValues = 0;
+
+        size_t size() const {return validity.size();}
+    };
+
+    // Columns of the fields written by 'program', kept by clear(). A sink
+    // already laid out for another program cannot be used for it.
+    void layout(const SchemaProgram& program);
+    const SchemaProgram* program() const {return source;}
+
+    // Written by the Engine: the value of the field at 'path' follows,
+    // 'indices' are the ones of all the arrays being decoded
+    void beginRow();
+    void field(uint32_t path, const std::vector<uint32_t>& indices);
+    void value(int64_t number);
+    void value(uint64_t number);
+    void value(double number);
+    void value(bool boolean);
+    void value(const char* text, size_t length);
+    void endRow();
+    void discardRow();
+
+    void appendError(const std::string& message);
+    void appendFiltered();
+
+    // Rows of another sink of the same program, after the ones here
+    void append(const ColumnarSink& other);
+
+    // Drop the rows but keep the columns and their capacity
+    void clear();
+
+    // Messages converted, and for each one whether it got a row
+    size_t size() const {return statuses.size();}
+    bool ok(size_t index) const {return statuses[index] == Status::OK;}
+    bool filtered(size_t index) const {return statuses[index] == Status::FILTERED;}
+    const std::string& error(size_t index) const;
+    size_t filtered() const {return filteredCount;}
+    size_t rows() const {return rowCount;}
+    const std::vector<Column>& columns() const {return table;}
+
+    // Arrow IPC stream format: a Schema message, with the type of the
+    // messages in its metadata ("openformat.type"), a RecordBatch message
+    // for each batch of rows and the end of stream marker. The columns are
+    // named by the pointers of their fields; the buffers of the body are
+    // aligned on 64 bytes.
+    void writeSchema(std::ostream& out, const std::string& type) const;
+    void writeBatch(std::ostream& out) const;
+    static void writeEnd(std::ostream& out);
+    // The rows as a whole stream of a single record batch
+    void writeTo(std::ostream& out, const std::string& type) const;
+
+private:
+    enum class Status : uint8_t {OK, FILTERED, ERROR};
+
+    const SchemaProgram* source = nullptr;
+    std::vector<Column> table;
+    std::vector<uint32_t> columnOf;     // by path
+    std::vector<uint32_t> touched;      // columns written in the current row
+    Column* current = nullptr;
+    bool overwrite = false;             // the value of 'current' replaces its last one
+    size_t rowCount = 0;
+    std::vector<Status> statuses;
+    std::vector<std::pair<size_t, std::string>> errors;     // by message
+    size_t filteredCount = 0;
+
+    static constexpr uint32_t noColumn = UINT32_MAX;
+
+    void appendNull(Column& column, size_t level);
+    void putWord(uint64_t word);
+    void putBit(bool bit);
+    void putText(const char* text, size_t length);
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "Logger.h"
+#include "MessageElement.h"
+
+
+// Existing condition compiled once when the schema is loaded. The reference
+// value is parsed into typed constants, sorted for 'in' and 'not in', so
+// checking a field costs a compare or a binary search. Numbers compare by
+// value whatever their representation (booleans count as 0 and 1), strings
+// compare as bytes and sort after every number.
+class ConditionPredicate {
+
+public:
+    using Type = MessageElementExistingCondition::MessageElementExistingConditionType;
+
+    struct Number {
+        enum class Kind {SIGNED, UNSIGNED, DECIMAL};
+        Kind kind = Kind::UNSIGNED;
+        int64_t i = 0;
+        uint64_t u = 0;
+        double d = 0;
+
+        static Number of(int64_t value) {Number n; n.kind = Kind::SIGNED; n.i = value; return n;}
+        static Number of(uint64_t value) {Number n; n.kind = Kind::UNSIGNED; n.u = value; return n;}
+        static Number of(double value) {Number n; n.kind = Kind::DECIMAL; n.d = value; return n;}
+    };
+
+    ConditionPredicate() {}
+
+    // The reference value is JSON text (a number, a boolean, a string or an
+    // array of them); anything else is taken as a plain string. An 'eq'
+    // without a reference value keeps its original meaning: the field is
+    // set to a non-zero value.
+    explicit ConditionPredicate(const MessageElementExistingCondition& condition): type(condition.getCondition()) {
+        const std::string& text = condition.getRefValue();
+        if(text.empty() && type == Type::DCT_EQUAL){
+            type = Type::DCT_NOT_EQUAL;
+            numbers.push_back(Number::of(uint64_t(0)));
+            return;
+        }
+        if(type == Type::DCT_UNDEFINED || type == Type::DCT_EXIST){
+            return;
+        }
+
+        auto value = nlohmann::json::parse(text, nullptr, false);
+        bool valid = true;
+        if(value.is_discarded()){
+            strings.push_back(text);
+        } else if(value.is_array()){
+            for(const auto& item : value){
+                valid = valid && add(item);
+            }
+        } else {
+            valid = add(value);
+        }
+        std::sort(numbers.begin(), numbers.end(), [](const Number& a, const Number& b){ return compare(a, b) < 0; });
+        std::sort(strings.begin(), strings.end());
+
+        size_t count = numbers.size() + strings.size();
+        bool single = type != Type::DCT_BETWEEN && type != Type::DCT_IN && type != Type::DCT_NOT_IN;
+        if(not valid || (single && count != 1) || (type == Type::DCT_BETWEEN && count != 2) || count == 0){
+            std::ostringstream oss;
+            oss << condition;
+            Logger::getInstance().log("Invalid reference value in existing condition <" + oss.str() + ">: the condition is ignored", Logger::Level::ERROR);
+            type = Type::DCT_UNDEFINED;
+            numbers.clear();
+            strings.clear();
+        }
+    }
+
+    Type getType() const {return type;}
+
+    // Result for a field that has not been decoded (or is not in the input)
+    bool missing() const {return type == Type::DCT_UNDEFINED;}
+
+    bool test(const Number& value) const {return holds(value);}
+    bool test(std::string_view value) const {return holds(value);}
+
+    template<typename Json>
+    bool testJson(const Json& value) const {
+        switch(value.type()){
+            case nlohmann::json::value_t::boolean:
+                return holds(Number::of(uint64_t(value.template get<bool>() ? 1 : 0)));
+            case nlohmann::json::value_t::number_integer:
+                return holds(Number::of(value.template get<int64_t>()));
+            case nlohmann::json::value_t::number_unsigned:
+                return holds(Number::of(value.template get<uint64_t>()));
+            case nlohmann::json::value_t::number_float:
+                return holds(Number::of(value.template get<double>()));
+            case nlohmann::json::value_t::string:
+                return holds(std::string_view(value.template get_ref<const std::string&>()));
+            default:
+                return missing();
+        }
+    }
+
+    static int compare(const Number& a, const Number& b) {
+        if(a.kind == Number::Kind::DECIMAL || b.kind == Number::Kind::DECIMAL){
+            double x = toDouble(a);
+            double y = toDouble(b);
+            return (x > y) - (x < y);
+        }
+        bool aNegative = a.kind == Number::Kind::SIGNED && a.i < 0;
+        bool bNegative = b.kind == Number::Kind::SIGNED && b.i < 0;
+        if(aNegative != bNegative){
+            return aNegative ? -1 : 1;
+        }
+        if(aNegative){
+            return (a.i > b.i) - (a.i < b.i);
+        }
+        uint64_t x = a.kind == Number::Kind::SIGNED ? static_cast<uint64_t>(a.i) : a.u;
+        uint64_t y = b.kind == Number::Kind::SIGNED ? static_cast<uint64_t>(b.i) : b.u;
+        return (x > y) - (x < y);
+    }
+
+private:
+    Type type = Type::DCT_UNDEFINED;
+    // Constants, in order: 'numbers' then 'strings', each sorted
+    std::vector<Number> numbers;
+    std::vector<std::string> strings;
+
+    bool add(const nlohmann::json& value) {
+        switch(value.type()){
+            case nlohmann::json::value_t::boolean:
+                numbers.push_back(Number::of(uint64_t(value.get<bool>() ? 1 : 0)));
+                return true;
+            case nlohmann::json::value_t::number_integer:
+                numbers.push_back(Number::of(value.get<int64_t>()));
+                return true;
+            case nlohmann::json::value_t::number_unsigned:
+                numbers.push_back(Number::of(value.get<uint64_t>()));
+                return true;
+            case nlohmann::json::value_t::number_float:
+                numbers.push_back(Number::of(value.get<double>()));
+                return true;
+            case nlohmann::json::value_t::string:
+                strings.push_back(value.get<std::string>());
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static double toDouble(const Number& n) {
+        switch(n.kind){
+            case Number::Kind::SIGNED: return static_cast<double>(n.i);
+            case Number::Kind::UNSIGNED: return static_cast<double>(n.u);
+            default: return n.d;
+        }
+    }
+
+    // Sign of 'value' minus the constant at 'index'
+    int compareAt(const Number& value, size_t index) const {
+        return index < numbers.size() ? compare(value, numbers[index]) : -1;
+    }
+
+    int compareAt(std::string_view value, size_t index) const {
+        if(index < numbers.size()){ return 1; }
+        int result = value.compare(strings[index - numbers.size()]);
+        return (result > 0) - (result < 0);
+    }
+
+    template<typename Value>
+    bool contains(const Value& value) const {
+        size_t low = 0;
+        size_t high = numbers.size() + strings.size();
+        while(low < high){
+            size_t middle = low + (high - low) / 2;
+            int result = compareAt(value, middle);
+            if(result == 0){ return true; }
+            if(result > 0){ low = middle + 1; } else { high = middle; }
+        }
+        return false;
+    }
+
+    template<typename Value>
+    bool holds(const Value& value) const {
+        switch(type){
+            case Type::DCT_EQUAL: return compareAt(value, 0) == 0;
+            case Type::DCT_NOT_EQUAL: return compareAt(value, 0) != 0;
+            case Type::DCT_GREATER_THAN: return compareAt(value, 0) > 0;
+            case Type::DCT_GREATER_THAN_OR_EQUAL_TO: return compareAt(value, 0) >= 0;
+            case Type::DCT_LOWER_THAN: return compareAt(value, 0) < 0;
+            case Type::DCT_LOWER_THAN_OR_EQUAL_TO: return compareAt(value, 0) <= 0;
+            case Type::DCT_BETWEEN: return compareAt(value, 0) >= 0 && compareAt(value, 1) <= 0;
+            case Type::DCT_IN: return contains(value);
+            case Type::DCT_NOT_IN: return not contains(value);
+            default: return true;
+        }
+    }
+};
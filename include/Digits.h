@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Unsigned integers written as decimal digits, most significant first:
+// either ASCII characters or packed BCD (two digits per byte, the first one
+// in the high nibble). Up to 19 digits, the most that always fit in 64 bits.
+// The 16 lowest digits are folded or spread with SSE4.1 multiply-adds,
+// selected at runtime, with a scalar fallback that parses 8 ASCII or 16 BCD
+// digits per 64 bit word.
+class Digits {
+public:
+    static constexpr size_t maxDigits = 19;
+
+    // Value of the 'count' digits at 'src' (BCD: 'count' nibbles from the
+    // high one of src[0]). False when one of them is not a digit or 'count'
+    // is 0 or above maxDigits.
+    static bool parseAscii(const char* src, size_t count, uint64_t& value);
+    static bool parseBcd(const unsigned char* src, size_t count, uint64_t& value);
+
+    // 'value' on exactly 'count' digits, padded with zeros (BCD: (count + 1) / 2
+    // bytes, the low nibble of the last one is 0 when 'count' is odd). False
+    // when it does not fit or 'count' is 0 or above maxDigits.
+    static bool formatAscii(uint64_t value, char* dst, size_t count);
+    static bool formatBcd(uint64_t value, unsigned char* dst, size_t count);
+
+    // Digits needed to write 'value'
+    static size_t length(uint64_t value);
+
+    // Name of the kernel selected for this CPU ("sse4.1" or "scalar")
+    static const char* implementation();
+    // Use the kernel 'name' instead, to compare them in the tests: false when
+    // this CPU does not run it. Not to be called while digits are converted.
+    static bool select(const char* name);
+};
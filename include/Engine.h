@@ -3,30 +3,192 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <string_view>
 #include <iostream>
 #include <stdexcept>
 #include <nlohmann/json.hpp>
+#include "Arena.h"
 #include "BitStream.h"
+#include "BitView.h"
+#include "BitWriter.h"
+#include "CborWriter.h"
+#include "Digits.h"
+#include "ColumnarSink.h"
+#include "JsonIndex.h"
+#include "JsonWriter.h"
+#include "MsgPackWriter.h"
 #include "SchemaCatalog.h"
 #include "MessageElement.h"
+#include "OutputSink.h"
+#include "Span.h"
+#include "ThreadPool.h"
 #include "Logger.h"
+#include "MessageFilter.h"
 
 
+// Encoding of the decoded messages, and of the documents to encode. CBOR
+// (RFC 8949) and MessagePack carry the same content as JSON.
+enum class DataFormat {JSON, CBOR, MSGPACK};
+
+struct DecodeOptions {
+    const SchemaProgram* projection = nullptr;  // only the fields it selects are written (see SchemaProgram::project())
+    const MessageFilter* filter = nullptr;      // messages that do not match it are abandoned
+    DataFormat format = DataFormat::JSON;
+};
+
 class Engine {
 public:
-    const std::pair<std::string, unsigned int> convertToBinary(const std::string&, const Schema*);
-    const std::string convertToJson(const std::string&, const std::string&, const Schema*);
+    const std::pair<std::string, unsigned int> convertToBinary(const std::string&, const Schema*, DataFormat = DataFormat::JSON);
+    const std::pair<std::string, unsigned int> convertToBytes(const std::string&, const Schema*, DataFormat = DataFormat::JSON);
+    const std::pair<std::string, unsigned int> convertToBinary(const nlohmann::ordered_json&, const Schema*);
+    const std::pair<std::string, unsigned int> convertToBytes(const nlohmann::ordered_json&, const Schema*);
+    // Empty when the message does not match the filter of 'options'
+    const std::string convertToJson(const std::string&, const std::string&, const Schema*, const DecodeOptions& options = {});
+    const std::string convertToJson(const unsigned char*, size_t, const std::string&, const Schema*, const DecodeOptions& options = {});
+
+    // Convert many messages of the same schema into 'sink', one entry per
+    // message in the same order. The views must stay valid during the call.
+    // The messages that do not match the filter are abandoned as soon as one
+    // of its clauses fails, and are marked as filtered in 'sink'.
+    void convertToJsonBatch(Span<const BitView>, const Schema*, OutputSink&, const DecodeOptions& options = {});
+    void convertToBinaryBatch(Span<const std::string_view>, const Schema*, OutputSink&, DataFormat = DataFormat::JSON);
+    // Same, with the fields written straight into the columns of 'sink' (the
+    // format of 'options' is not used)
+    void convertToColumns(Span<const BitView>, const Schema*, ColumnarSink&, const DecodeOptions& options = {});
+
+    // Same, split in chunks of 'chunk' messages converted in parallel on
+    // 'pool' by the engines of its threads; 'sink' is in input order all the same
+    static void convertToJsonBatch(ThreadPool&, Span<const BitView>, const Schema*, OutputSink&,
+                                   const DecodeOptions& options = {}, size_t chunk = defaultChunk);
+    static void convertToBinaryBatch(ThreadPool&, Span<const std::string_view>, const Schema*, OutputSink&,
+                                     DataFormat = DataFormat::JSON, size_t chunk = defaultChunk);
+    static void convertToColumns(ThreadPool&, Span<const BitView>, const Schema*, ColumnarSink&,
+                                 const DecodeOptions& options = {}, size_t chunk = defaultChunk);
+
+    // Engine of the calling thread, reused by all its conversions
+    static Engine& local();
+    static constexpr size_t defaultChunk = 1024;
+
+    // Forget the previous message but keep every buffer, so that an engine
+    // reused for many messages stops allocating once it has met the largest
+    // one. Called by each conversion.
+    void reset();
 
 private:
-    void analizeElement(const MessageElement&, const std::string&);
-    void analizeStructure(const std::vector<MessageElement>&, const std::string&);
-    bool evaluateExistingConditions(const std::vector<MessageElementExistingCondition>&);
-    void analizeJsonElement(const MessageElement&, const std::string&);
-    void analizeJsonStructure(const std::vector<MessageElement>&, const std::string&);
+    void load(const BitView&);
+    void prepare(const Schema*, const DecodeOptions&);
+    void decode(const Schema*, const DecodeOptions&);
+    const std::string& decoded() const;
+    void encode(std::string_view, const Schema*, DataFormat);
+    void encode(const nlohmann::ordered_json&, const Schema*);
+    void beginEncoding();
+    void endEncoding();
+    void resumeEncoding();
+    bool nextItem();
+    void enterItem(bool);
+    bool closed(uint32_t) const;
+    // Written the same way by each writer of the formats
+    template<typename Writer> void execute(Writer&);
+    template<typename Writer> int decodeField(const Instruction&, Writer&);
+    template<typename Writer> void decodeFixed(const Instruction&, uint64_t, Writer&);
+    uint64_t readDigits(const Instruction&, const BitView&, bool&);
+    template<typename Writer> void openMember(uint32_t, Writer&);
+    template<typename Writer> void openKey(const PathSegment&, size_t, Writer&);
+    template<typename Writer> void closeLevels(size_t, Writer&);
+    bool evaluateConditions(const std::vector<CompiledCondition>&);
+    void encodeField(const Instruction&, const JsonIndex::Value*, std::string_view);
+    void writeDigits(const Instruction&, uint64_t, bool);
     std::string getTypeString(nlohmann::json::value_t);
+    static unsigned int minimumBytes(uint64_t);
+
+    // The document to encode is read by a SAX parser (DocumentReader) while
+    // the program runs: the program stops where it needs a value not met
+    // yet and goes on when the parser meets it
+    class DocumentReader;
+    enum class Wait {NONE, FIELD, ITEM};
+    // Container of the document open in the parser, and its member being read
+    struct Step {
+        bool array = false;
+        uint32_t next = 0;      // index of the next item of an array
+        uint32_t index = 0;     // of the member, in an array
+        std::string name;       // of the member, in an object
+        bool stashed = false;   // values below it have been kept in 'document'
+    };
+    void offer(const JsonIndex::Value&, std::string_view);
+    void nextMember();
+    void enterContainer(bool);
+    void leaveContainer();
+    bool atPath(const std::vector<PathSegment>&, size_t) const;
+    std::string stepsPointer(size_t) const;
+    std::string pathPointer(uint32_t, size_t = SIZE_MAX) const;
+
+    JsonIndex document;             // values met before the program needs them
+    std::vector<Step> steps;
+    size_t depth = 0;               // steps in use
+    std::vector<std::string> closedArrays;  // read whole while values below them were kept
+    uint32_t encodePc = 0;
+    uint32_t itemLoop = 0;          // OP_LOOP waiting for its next item
+    int encodeRoute = 0;
+    Wait waiting = Wait::NONE;
+    bool documentEnded = false;
+    bool encoding = false;          // the program has not reached its end
+
+    // Value of a field that is needed after it has been decoded (see
+    // SchemaProgram::allocateRegisters), and where it has been written in the output
+    struct Register {
+        uint64_t raw = 0;       // bits as read, right aligned
+        uint64_t value = 0;     // integers and booleans
+        double decimal = 0;
+        std::string text;       // strings
+        MessageElement::MessageElementType type = MessageElement::MessageElementType::MET_UNDEFINED;
+        uint32_t bits = 0;
+        bool set = false;
+        size_t outputOffset = 0;
+        size_t outputLength = 0;
+
+        // Back to the initial state, keeping the capacity of 'text'
+        void clear() {
+            raw = 0;
+            value = 0;
+            decimal = 0;
+            text.clear();
+            type = MessageElement::MessageElementType::MET_UNDEFINED;
+            bits = 0;
+            set = false;
+            outputOffset = 0;
+            outputLength = 0;
+        }
+    };
+    // Container open in the output, below the root
+    struct Level {
+        PathSegment segment;
+        uint32_t index;     // array index of 'segment', if it is one
+        bool array;         // kind of container opened by 'segment'
+    };
+    template<typename Writer> size_t beginValue(uint32_t, bool, Writer&);
+    template<typename Writer> void endValue(Register&, size_t, bool, Writer&);
+    static bool holds(const ConditionPredicate&, const Register&, std::string_view);
+    bool filterField(uint32_t, const Register&, std::string_view);
+    bool filterMessage();
 
-    nlohmann::ordered_json jsonFlatten;
-    std::unordered_map<std::string, std::unique_ptr<BitStream>> bitStreamMap;
-    BitStream* bitStream;
+    std::vector<Register> registers;
+    std::vector<uint32_t> indices;  // index of each enclosing array
+    std::vector<int> loops;         // repetitions of each enclosing array
+    std::vector<uint64_t> fixedValues;  // bits of the fields of an OP_BLOCK
+    std::vector<Level> levels;
+    bool rootArray = false;
+    bool rootOpen = false;
+    JsonWriter output;
+    CborWriter cborOutput;
+    MsgPackWriter msgpackOutput;
+    DataFormat format = DataFormat::JSON;   // of the last message decoded
+    BitStream bitStream;
+    Arena arena;                    // temporaries of the current message
+    size_t lastOutputSize = 0;      // to size the output of a batch
+    BitWriter bitWriter;
     const Schema* schema;
+    const SchemaProgram* program;   // being executed for 'schema'
+    const MessageFilter* filter = nullptr;
+    std::vector<char> filterSeen;   // clauses of 'filter' checked at least once
+    bool rejected = false;          // the message does not match 'filter'
 };
\ No newline at end of file
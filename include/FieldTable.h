@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include "MessageElement.h"
+#include "ConditionPredicate.h"
+#include "RoutingTable.h"
+
+
+// Plain description of a schema element. Descriptors only refer to each
+// other by index in the owning FieldTable: the members of a structure are
+// stored contiguously, and so are the routes and the existing conditions of
+// an element.
+struct FieldDescriptor {
+    MessageElement::MessageElementType type = MessageElement::MessageElementType::MET_UNDEFINED;
+    MessageElement::NumericEncodingType encoding = MessageElement::NumericEncodingType::NE_BINARY;
+    uint32_t name = 0;                  // interned name
+    uint32_t bitLength = 0;
+    int32_t delimiter = 0;
+    int32_t repetitions = 1;            // arrays: count, -1 up to the end, 0 taken from 'repetitionsReference'
+    uint32_t repetitionsReference = 0;  // interned path
+    uint32_t extend = 0;                // interned path of the extended field
+    uint32_t firstChild = 0;            // structure members: fields[firstChild, firstChild + childCount)
+    uint32_t childCount = 0;
+    uint32_t firstRoute = 0;            // routes[firstRoute, firstRoute + routeCount), ordered by key
+    uint32_t routeCount = 0;
+    uint32_t routingTable = 0;          // dispatch on the routes, in FieldTable::routingTables
+    uint32_t firstCondition = 0;        // conditions[firstCondition, firstCondition + conditionCount)
+    uint32_t conditionCount = 0;
+    bool visible = true;
+    bool delimited = false;
+    bool array = false;
+    bool flatten = false;
+};
+
+struct FieldRoute {
+    int key;
+    uint32_t field;
+};
+
+struct FieldCondition {
+    uint32_t reference;     // interned path of the referenced field
+    ConditionPredicate predicate;
+};
+
+// Immutable, flattened copy of a schema structure built once when the catalog
+// is loaded. Everything lives in a few contiguous vectors and names are stored
+// once, so walking the schema never copies a string or a container.
+class FieldTable {
+public:
+    std::vector<FieldDescriptor> fields;    // the top-level structure is fields[0, rootCount)
+    std::vector<FieldRoute> routes;
+    std::vector<RoutingTable> routingTables;    // routing key -> index in 'fields'
+    std::vector<FieldCondition> conditions;
+    uint32_t rootCount = 0;
+
+    static std::shared_ptr<const FieldTable> build(const std::vector<MessageElement>&);
+
+    const std::string& name(uint32_t id) const {return names[id];}
+    const FieldDescriptor* children(const FieldDescriptor& field) const {return fields.data() + field.firstChild;}
+    // Index of the field selected by 'key', RoutingTable::npos if none
+    uint32_t findRoute(const FieldDescriptor& field, int key) const {return routingTables[field.routingTable].find(key);}
+
+private:
+    std::vector<std::string> names;     // names[0] is the empty string
+    std::unordered_map<std::string, uint32_t> nameIndex;
+
+    uint32_t intern(const std::string&);
+    uint32_t place(const std::vector<MessageElement>&);
+    void fill(uint32_t, const MessageElement&);
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "BitView.h"
+
+
+// How the end of a message is found in a stream of back-to-back messages
+// (see StreamDecoder), from the <framing> section of the schema:
+//   {"type": "fixed", "byte_length": 8}
+//   {"type": "length", "field": "/length", "unit": 1, "adjustment": 4}
+//   {"type": "terminator", "terminator": "\u000110=", "trailer_length": 4}
+// A length field must be at a fixed position; the message is 'unit' bytes
+// per unit of its value plus 'adjustment' bytes long. A terminator can be
+// followed by 'trailer_length' bytes still part of the message. Schemas
+// without a <framing> section are framed as fixed when all their fields
+// have a fixed size.
+struct Framing {
+    enum class Type {NONE, FIXED, LENGTH, TERMINATOR};
+
+    Type type = Type::NONE;
+    size_t byteLength = 0;          // FIXED
+    size_t lengthOffset = 0;        // LENGTH: bit position of the length field
+    unsigned int lengthBits = 0;    // LENGTH: size of the length field
+    int64_t lengthUnit = 1;         // LENGTH
+    int64_t lengthAdjustment = 0;   // LENGTH
+    std::string terminator;         // TERMINATOR
+    size_t trailerLength = 0;       // TERMINATOR
+
+    static constexpr size_t incomplete = 0;
+
+    // Size in bytes of the message at the start of 'data', or 'incomplete'
+    // if more than 'available' bytes are needed to know it. 'scanned' keeps
+    // how far a terminator has already been looked for between calls.
+    size_t frameLength(const unsigned char* data, size_t available, size_t& scanned) const {
+        switch(type){
+            case Type::FIXED:
+                return available >= byteLength ? byteLength : incomplete;
+            case Type::LENGTH:
+                {
+                    size_t header = (lengthOffset + lengthBits + 7) >> 3;
+                    if(available < header){
+                        return incomplete;
+                    }
+                    uint64_t value = BitView(data, lengthOffset, lengthBits, available).readU64(0, lengthBits);
+                    int64_t length = static_cast<int64_t>(value) * lengthUnit + lengthAdjustment;
+                    if(length <= 0 || static_cast<size_t>(length) < header){
+                        throw std::invalid_argument("Invalid message length <" + std::to_string(length) + "> from a length field of value <" +
+                                                    std::to_string(value) + ">");
+                    }
+                    return available >= static_cast<size_t>(length) ? static_cast<size_t>(length) : incomplete;
+                }
+            case Type::TERMINATOR:
+                {
+                    // Start again where the last search stopped, minus a partial match
+                    size_t from = scanned >= terminator.size() ? scanned - terminator.size() + 1 : 0;
+                    const unsigned char* end = data + available;
+                    const unsigned char* found = std::search(data + from, end, terminator.begin(), terminator.end(),
+                        [](unsigned char a, char b){ return a == static_cast<unsigned char>(b); });
+                    if(found == end){
+                        scanned = available;
+                        return incomplete;
+                    }
+                    size_t length = static_cast<size_t>(found - data) + terminator.size() + trailerLength;
+                    return available >= length ? length : incomplete;
+                }
+            default:
+                throw std::invalid_argument("The schema does not define how its messages are framed");
+        }
+    }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "BitView.h"
+#include "BitWriter.h"
+#include "JsonWriter.h"
+
+
+// Decoder and encoder generated ahead of time for one schema by
+// openformat-codegen. Both return false, leaving their output in an
+// unspecified state, when they meet anything they do not handle (a message
+// too short, an unknown routing key, a missing or mistyped input value): the
+// Engine then runs the interpreter, which reports the error.
+struct GeneratedCodec {
+    const char* schema;         // catalog name
+    uint64_t fingerprint;       // of the schema the code was generated from
+    bool (*decode)(const unsigned char* data, size_t bitLength, size_t lengthInBytes, JsonWriter& output);
+    bool (*encode)(const nlohmann::ordered_json& input, BitWriter& output);
+
+    // FNV-1a of the schema as parsed, so that formatting does not matter
+    static uint64_t fingerprintOf(const nlohmann::ordered_json& schema) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for(unsigned char c : schema.dump()){
+            hash = (hash ^ c) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    // Lookups in the input following the JSON pointer rules: a token selects
+    // an object member or, when it is a number, an array item
+    static const nlohmann::ordered_json* member(const nlohmann::ordered_json* parent, const char* token) {
+        if(parent == nullptr){ return nullptr; }
+        if(parent->is_object()){
+            auto it = parent->find(token);
+            return it == parent->end() ? nullptr : &*it;
+        }
+        if(parent->is_array()){
+            size_t index = 0;
+            const char* c = token;
+            if(*c == '\0' || (*c == '0' && c[1] != '\0')){ return nullptr; }
+            for(; *c; c++){
+                if(*c < '0' || *c > '9'){ return nullptr; }
+                index = index * 10 + static_cast<size_t>(*c - '0');
+            }
+            return index < parent->size() ? &(*parent)[index] : nullptr;
+        }
+        return nullptr;
+    }
+
+    static const nlohmann::ordered_json* item(const nlohmann::ordered_json* parent, size_t index) {
+        if(parent == nullptr){ return nullptr; }
+        if(parent->is_array()){
+            return index < parent->size() ? &(*parent)[index] : nullptr;
+        }
+        return member(parent, std::to_string(index).c_str());
+    }
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+
+// Values of a document to encode that the SAX parser met before the encoder
+// needed them, by JSON pointer ("/data/0"). The encoder walks the program of
+// the schema while the document is parsed: a value met where the program
+// expects it is written at once and never lands here, so the index stays
+// empty while the document follows the order of the schema. The pointers and
+// the strings are kept in two buffers reused from one message to the next.
+class JsonIndex {
+
+public:
+    struct Value {
+        nlohmann::json::value_t type;
+        union {
+            int64_t integer;
+            uint64_t unsignedInteger;
+            double decimal;
+            bool boolean;
+        };
+        uint32_t pointer;
+        uint32_t pointerLength;
+        uint32_t text;              // strings
+        uint32_t textLength;
+        bool used;                  // taken by the encoder
+
+        int64_t asInteger() const {return type == nlohmann::json::value_t::number_unsigned ? static_cast<int64_t>(unsignedInteger) : integer;}
+        uint64_t asUnsigned() const {return type == nlohmann::json::value_t::number_integer ? static_cast<uint64_t>(integer) : unsignedInteger;}
+    };
+
+    void clear();
+    void add(std::string_view pointer, Value value, std::string_view text);
+
+    // Value at 'pointer' marked as used, null if none
+    const Value* take(std::string_view pointer);
+    // Whether a value not used yet lies at or below 'pointer'
+    bool contains(std::string_view pointer) const;
+
+    std::string_view pointer(const Value& value) const {return std::string_view(pointers.data() + value.pointer, value.pointerLength);}
+    std::string_view text(const Value& value) const {return std::string_view(texts.data() + value.text, value.textLength);}
+
+    size_t size() const {return values.size();}
+    // Values not taken yet
+    size_t unused() const {return values.size() - usedCount;}
+
+    // "pointer": value, for the logs
+    std::string toString(bool unusedOnly = false) const;
+
+    // Key of an object as a step of a JSON pointer (RFC 6901)
+    static void appendKey(std::string& pointer, std::string_view key);
+
+private:
+    std::vector<Value> values;          // in the order of the document
+    std::string pointers;
+    std::string texts;
+    std::unordered_map<std::string, uint32_t> byPointer;
+    size_t usedCount = 0;
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// Streaming JSON serializer writing into a single reusable buffer. Object
+// keys are expected pre-rendered (quoted, escaped and followed by ':'), as
+// produced by renderKey(), so writing a member is a couple of appends.
+class JsonWriter {
+
+public:
+    // Drop the content but keep the capacity
+    void clear() {
+        buffer.clear();
+        first.clear();
+    }
+
+    void reserve(size_t bytes) {
+        buffer.reserve(bytes);
+    }
+
+    void beginObject() {
+        buffer += '{';
+        first.push_back(true);
+    }
+
+    void endObject() {
+        buffer += '}';
+        first.pop_back();
+    }
+
+    void beginArray() {
+        buffer += '[';
+        first.push_back(true);
+    }
+
+    void endArray() {
+        buffer += ']';
+        first.pop_back();
+    }
+
+    // Start a new member of the innermost container: 'key' is empty for
+    // array items
+    void member(const std::string& key) {
+        if(not first.empty()){
+            if(not first.back()){ buffer += ','; }
+            first.back() = false;
+        }
+        buffer += key;
+    }
+
+    void value(int64_t number) {
+        char digits[24];
+        buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), number).ptr);
+    }
+
+    void value(uint64_t number) {
+        char digits[24];
+        buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), number).ptr);
+    }
+
+    // Shortest representation that reads back to the same value, laid out
+    // as nlohmann::json does: plain notation with at least one decimal for
+    // exponents in [-5, 14], scientific notation otherwise
+    void value(double number) {
+        if(not std::isfinite(number)){
+            buffer += "null";
+            return;
+        }
+        char scientific[32];
+        char* end = std::to_chars(scientific, scientific + sizeof(scientific), number, std::chars_format::scientific).ptr;
+        const char* it = scientific;
+        if(*it == '-'){
+            buffer += '-';
+            it++;
+        }
+        char digits[20];
+        int k = 0;
+        for(; *it != 'e'; it++){
+            if(*it != '.'){ digits[k++] = *it; }
+        }
+        int exponent = 0;
+        std::from_chars(it + (it[1] == '+' ? 2 : 1), end, exponent);
+        int n = exponent + 1;   // position of the decimal point in 'digits'
+        if(k <= n && n <= 15){
+            buffer.append(digits, k);
+            buffer.append(n - k, '0');
+            buffer += ".0";
+        } else if(0 < n && n <= 15){
+            buffer.append(digits, n);
+            buffer += '.';
+            buffer.append(digits + n, k - n);
+        } else if(-4 < n && n <= 0){
+            buffer += "0.";
+            buffer.append(-n, '0');
+            buffer.append(digits, k);
+        } else {
+            buffer += digits[0];
+            if(k > 1){
+                buffer += '.';
+                buffer.append(digits + 1, k - 1);
+            }
+            buffer += exponent < 0 ? "e-" : "e+";
+            int magnitude = exponent < 0 ? -exponent : exponent;
+            if(magnitude < 10){ buffer += '0'; }
+            char exponentDigits[8];
+            buffer.append(exponentDigits, std::to_chars(exponentDigits, exponentDigits + sizeof(exponentDigits), magnitude).ptr);
+        }
+    }
+
+    void value(bool boolean) {
+        buffer += boolean ? "true" : "false";
+    }
+
+    void value(const char* text, size_t length) {
+        buffer += '"';
+        escape(buffer, text, length);
+        buffer += '"';
+    }
+
+    void null() {
+        buffer += "null";
+    }
+
+    // Replace 'length' bytes at 'offset' with 'text', used to update a value
+    // already written
+    void replace(size_t offset, size_t length, const std::string& text) {
+        buffer.replace(offset, length, text);
+    }
+
+    void replace(size_t offset, size_t length, const char* text, size_t textLength) {
+        buffer.replace(offset, length, text, textLength);
+    }
+
+    // Drop everything written from 'offset' on
+    void truncate(size_t offset) {
+        buffer.resize(offset);
+    }
+
+    size_t size() const {return buffer.size();}
+    const std::string& str() const {return buffer;}
+
+    // "name": ready to be passed to member()
+    static std::string renderKey(const std::string& name) {
+        std::string key = "\"";
+        escape(key, name.data(), name.size());
+        key += "\":";
+        return key;
+    }
+
+    // Escape 'text' as the content of a JSON string. Multi-byte UTF-8
+    // sequences are copied as they are, invalid ones are rejected.
+    static void escape(std::string& out, const char* text, size_t length) {
+        static const char hex[] = "0123456789abcdef";
+        size_t plain = 0;
+        for(size_t i = 0; i < length; i++){
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if(c >= 0x20 && c != '"' && c != '\\' && c < 0x80){
+                continue;
+            }
+            out.append(text + plain, i - plain);
+            if(c >= 0x80){
+                size_t sequence = utf8Length(reinterpret_cast<const unsigned char*>(text) + i, length - i);
+                if(sequence == 0){
+                    invalidUtf8(i, c);
+                }
+                out.append(text + i, sequence);
+                i += sequence - 1;
+            } else {
+                switch(c){
+                    case '"': out += "\\\""; break;
+                    case '\\': out += "\\\\"; break;
+                    case '\b': out += "\\b"; break;
+                    case '\f': out += "\\f"; break;
+                    case '\n': out += "\\n"; break;
+                    case '\r': out += "\\r"; break;
+                    case '\t': out += "\\t"; break;
+                    default:
+                        out += "\\u00";
+                        out += hex[c >> 4];
+                        out += hex[c & 0xf];
+                        break;
+                }
+            }
+            plain = i + 1;
+        }
+        out.append(text + plain, length - plain);
+    }
+
+    // Throw, as escape() does, if 'text' is not valid UTF-8
+    static void validateUtf8(const char* text, size_t length) {
+        for(size_t i = 0; i < length; i++){
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if(c < 0x80){
+                continue;
+            }
+            size_t sequence = utf8Length(reinterpret_cast<const unsigned char*>(text) + i, length - i);
+            if(sequence == 0){
+                invalidUtf8(i, c);
+            }
+            i += sequence - 1;
+        }
+    }
+
+private:
+    std::string buffer;
+    std::vector<bool> first;    // per open container: no member written yet
+
+    [[noreturn]] static void invalidUtf8(size_t index, unsigned char c) {
+        static const char hex[] = "0123456789abcdef";
+        throw std::invalid_argument("Invalid UTF-8 byte at index " + std::to_string(index) + ": 0x" +
+                                    hex[c >> 4] + hex[c & 0xf]);
+    }
+
+    // Length of the well-formed UTF-8 sequence at 'text', 0 if invalid
+    static size_t utf8Length(const unsigned char* text, size_t available) {
+        unsigned char c = text[0];
+        size_t length;
+        uint32_t codePoint;
+        if(c >= 0xc2 && c <= 0xdf){ length = 2; codePoint = c & 0x1f; }
+        else if(c >= 0xe0 && c <= 0xef){ length = 3; codePoint = c & 0x0f; }
+        else if(c >= 0xf0 && c <= 0xf4){ length = 4; codePoint = c & 0x07; }
+        else { return 0; }
+        if(available < length){ return 0; }
+        for(size_t i = 1; i < length; i++){
+            if((text[i] & 0xc0) != 0x80){ return 0; }
+            codePoint = (codePoint << 6) | (text[i] & 0x3f);
+        }
+        // Reject overlong forms, surrogates and values above U+10FFFF
+        if((length == 3 && codePoint < 0x800) || (length == 4 && codePoint < 0x10000) ||
+           (codePoint >= 0xd800 && codePoint <= 0xdfff) || codePoint > 0x10ffff){
+            return 0;
+        }
+        return length;
+    }
+};
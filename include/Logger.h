@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <fstream>
 #include <chrono>
 #include <iomanip>
 
@@ -32,8 +33,13 @@ class Logger {
         output = static_cast<unsigned int>(output_);
     }
     
+    // To skip building messages that would be discarded
+    bool isEnabled(Level logLevel) const {
+        return static_cast<unsigned int>(logLevel) >= severity;
+    }
+
     void log(const std::string& message, Level logLevel) {
-        if(static_cast<unsigned int>(logLevel) < severity){ return; }
+        if(not isEnabled(logLevel)){ return; }
         auto now = std::chrono::system_clock::now();
         auto now_ms = std::chrono::time_point_cast<std::chrono::microseconds>(now);
         auto value = now_ms.time_since_epoch().count();
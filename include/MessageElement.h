@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <map>
 #include <Logger.h>
 
 class MessageElementExistingCondition {
@@ -23,8 +25,8 @@ public:
                                       MessageElementExistingConditionType condition_):
         ref_field(ref_field_), ref_value(ref_value_), condition(condition_), is_set(true) {}
     const bool isSet() const {return is_set;}
-    const std::string getRefField() const {return ref_field;};
-    const std::string getRefValue() const {return ref_value;};
+    const std::string& getRefField() const {return ref_field;};
+    const std::string& getRefValue() const {return ref_value;};
     const MessageElementExistingConditionType getCondition() const {return condition;};
     friend std::ostream& operator<<(std::ostream& os, const MessageElementExistingCondition& obj) {
         if(obj.is_set){
@@ -145,37 +147,36 @@ public:
         return repetitionsReference;
     }    
     MessageElementType setType(MessageElementType type_) {type = type_; return type;}
-    std::vector<MessageElementExistingCondition> setExistingConditions(const std::vector<MessageElementExistingCondition>& existingConditions_) {
+    const std::vector<MessageElementExistingCondition>& setExistingConditions(const std::vector<MessageElementExistingCondition>& existingConditions_) {
         existingConditions = existingConditions_;
         return existingConditions;
     }
-    std::vector<MessageElement> setStructure(const std::vector<MessageElement>& structure_) {
+    const std::vector<MessageElement>& setStructure(const std::vector<MessageElement>& structure_) {
         structure = structure_;
         return structure;
     }
-    std::map<int, MessageElement> setRouting(const std::map<int, MessageElement>& routing_) {
+    const std::map<int, MessageElement>& setRouting(const std::map<int, MessageElement>& routing_) {
         routing = routing_;
         return routing;
     }
     NumericEncodingType setNumericEncoding(const NumericEncodingType numeric_encoding_) {numeric_encoding = numeric_encoding_; return numeric_encoding;}
     
-    std::string getName() const {return name;}
+    const std::string& getName() const {return name;}
     size_t getBitLength() const {return bitLength;}
     int getRepetitions() const {return repetitions;}
-    std::string getExtendElement() const {return extend_element;}
+    const std::string& getExtendElement() const {return extend_element;}
     int getDelimiter() const {return delimiter;}
     bool isVisible() const {return is_visible;}
     bool isFlattenStructure() const {return is_flatten_structure;}
-    std::string getRepetitionsReference() const {return repetitionsReference;}
+    const std::string& getRepetitionsReference() const {return repetitionsReference;}
     MessageElementType getType() const {return type;}
-    const std::vector<MessageElementExistingCondition> getExistingConditions() const {return existingConditions;}
-    const std::vector<MessageElement> getStructure() const {return structure;}
-    const std::map<int, MessageElement> getRouting() const {return routing;}
+    const std::vector<MessageElementExistingCondition>& getExistingConditions() const {return existingConditions;}
+    const std::vector<MessageElement>& getStructure() const {return structure;}
+    const std::map<int, MessageElement>& getRouting() const {return routing;}
     NumericEncodingType getNumericEncoding() const {return numeric_encoding;}
 
     const bool isDelimited() const {return is_delimited;} 
     const bool isArray() const {return is_array;} 
-    const bool forceIsArray(bool is_array_) const {is_array = is_array_; return is_array;} 
 
     friend std::ostream& operator<<(std::ostream& os, const MessageElement& obj) {
         os << "{\"name\":\"" << obj.name << "\", \"bit_length\":" << obj.bitLength <<  "\", \"size\":" << obj.repetitions << ", \"type\":\"" << obj.MessageElementTypeToString(obj.type) << "\"";
@@ -276,10 +277,10 @@ private:
     int delimiter = 0;
     NumericEncodingType numeric_encoding = NumericEncodingType::NE_BINARY;
 
-    mutable bool is_delimited = false;
-    mutable bool is_array = false;
-    mutable bool is_visible = true;
-    mutable bool is_flatten_structure = false;
+    bool is_delimited = false;
+    bool is_array = false;
+    bool is_visible = true;
+    bool is_flatten_structure = false;
     std::string extend_element = "";
     MessageElementType type;
     std::vector<MessageElementExistingCondition> existingConditions;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ConditionPredicate.h"
+#include "SchemaProgram.h"
+
+
+// Filter on the decoded values of a schema, checked by the Engine as soon
+// as each field is read so that a message that does not match is abandoned
+// without building its output. Every expression must hold:
+//
+//     <pointer> <operator> <value>
+//
+// with the pointer of a field ('*' in place of the array indices), an
+// operator among == != < <= > >= or the names used by the existing
+// conditions (eq, neq, lt, lte, gt, gte, between, in, nin) and a value in
+// JSON (integers also in hexadecimal, 0x123). A clause on a repeated field
+// must hold for all its values; a message without the field never matches.
+class MessageFilter {
+
+public:
+    struct Clause {
+        uint32_t path;
+        uint32_t reg;           // register of the field, if any
+        bool deferred;          // checked at the end of the message, on the final value of the field
+        ConditionPredicate predicate;
+        std::string expression;
+    };
+
+    static std::shared_ptr<const MessageFilter> compile(const SchemaProgram&, const std::vector<std::string>&);
+
+    size_t size() const {return clauses.size();}
+    const Clause& clause(size_t index) const {return clauses[index];}
+
+    // Clauses checked when the field at 'path' is read: [first, last)
+    bool watches(uint32_t path) const {return path + 1 < offsets.size() && offsets[path] != offsets[path + 1];}
+    uint32_t first(uint32_t path) const {return offsets[path];}
+    uint32_t last(uint32_t path) const {return offsets[path + 1];}
+
+    // Fields to be read for the filter, even if not in the output
+    const std::vector<std::string>& pointers() const {return fieldPointers;}
+
+private:
+    std::vector<Clause> clauses;        // not deferred ones first, by path
+    std::vector<uint32_t> offsets;      // by path: first of its clauses
+    std::vector<std::string> fieldPointers;
+
+    static Clause parse(const SchemaProgram&, const std::string&);
+};
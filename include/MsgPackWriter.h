@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include "JsonWriter.h"
+
+
+// Streaming MessagePack serializer with the interface of JsonWriter.
+// MessagePack needs the number of items before a container, so every
+// container is written with a 32 bit count patched when it ends: its header
+// keeps the same size, so the offsets of the values already written (see
+// replace()) stay valid. Object keys are pre-rendered by renderKey(); the
+// scalars take the shortest form.
+class MsgPackWriter {
+
+public:
+    void clear() {
+        buffer.clear();
+        containers.clear();
+    }
+
+    void reserve(size_t bytes) {
+        buffer.reserve(bytes);
+    }
+
+    void beginObject() {begin(0xdf);}
+    void endObject() {end();}
+    void beginArray() {begin(0xdd);}
+    void endArray() {end();}
+
+    // 'key' is empty for array items
+    void member(const std::string& key) {
+        if(not containers.empty()){
+            containers.back().count++;
+        }
+        buffer += key;
+    }
+
+    void value(int64_t number) {
+        if(number >= 0){
+            value(static_cast<uint64_t>(number));
+        } else if(number >= -32){
+            buffer += static_cast<char>(number);
+        } else if(number >= INT8_MIN){
+            typed(0xd0, static_cast<uint8_t>(number), 1);
+        } else if(number >= INT16_MIN){
+            typed(0xd1, static_cast<uint16_t>(number), 2);
+        } else if(number >= INT32_MIN){
+            typed(0xd2, static_cast<uint32_t>(number), 4);
+        } else {
+            typed(0xd3, static_cast<uint64_t>(number), 8);
+        }
+    }
+
+    void value(uint64_t number) {
+        if(number < 128){
+            buffer += static_cast<char>(number);
+        } else if(number <= UINT8_MAX){
+            typed(0xcc, number, 1);
+        } else if(number <= UINT16_MAX){
+            typed(0xcd, number, 2);
+        } else if(number <= UINT32_MAX){
+            typed(0xce, number, 4);
+        } else {
+            typed(0xcf, number, 8);
+        }
+    }
+
+    void value(double number) {
+        if(not std::isfinite(number)){
+            null();
+            return;
+        }
+        if(number >= std::numeric_limits<float>::lowest() && number <= std::numeric_limits<float>::max() &&
+           static_cast<double>(static_cast<float>(number)) == number){
+            float single = static_cast<float>(number);
+            uint32_t bits;
+            std::memcpy(&bits, &single, sizeof(bits));
+            typed(0xca, bits, 4);
+        } else {
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            typed(0xcb, bits, 8);
+        }
+    }
+
+    void value(bool boolean) {
+        buffer += static_cast<char>(boolean ? 0xc3 : 0xc2);
+    }
+
+    void value(const char* text, size_t length) {
+        JsonWriter::validateUtf8(text, length);
+        string(buffer, length);
+        buffer.append(text, length);
+    }
+
+    void null() {
+        buffer += static_cast<char>(0xc0);
+    }
+
+    void replace(size_t offset, size_t length, const char* text, size_t textLength) {
+        buffer.replace(offset, length, text, textLength);
+        // The counts of the containers still open after it have moved
+        for(auto& container : containers){
+            if(container.offset > offset){
+                container.offset = container.offset + textLength - length;
+            }
+        }
+    }
+
+    void truncate(size_t offset) {
+        buffer.resize(offset);
+    }
+
+    size_t size() const {return buffer.size();}
+    const std::string& str() const {return buffer;}
+
+    // String 'name', ready to be passed to member()
+    static std::string renderKey(const std::string& name) {
+        std::string key;
+        string(key, name.size());
+        key += name;
+        return key;
+    }
+
+private:
+    struct Container {
+        size_t offset;      // of the count
+        uint32_t count;
+    };
+    std::string buffer;
+    std::vector<Container> containers;
+
+    static void bigEndian(std::string& out, uint64_t value, int bytes) {
+        for(int shift = (bytes - 1) * 8; shift >= 0; shift -= 8){
+            out += static_cast<char>((value >> shift) & 0xff);
+        }
+    }
+
+    void typed(unsigned char type, uint64_t value, int bytes) {
+        buffer += static_cast<char>(type);
+        bigEndian(buffer, value, bytes);
+    }
+
+    static void string(std::string& out, size_t length) {
+        if(length < 32){
+            out += static_cast<char>(0xa0 | length);
+        } else if(length <= UINT8_MAX){
+            out += static_cast<char>(0xd9);
+            bigEndian(out, length, 1);
+        } else if(length <= UINT16_MAX){
+            out += static_cast<char>(0xda);
+            bigEndian(out, length, 2);
+        } else {
+            out += static_cast<char>(0xdb);
+            bigEndian(out, length, 4);
+        }
+    }
+
+    void begin(unsigned char type) {
+        buffer += static_cast<char>(type);
+        containers.push_back(Container{buffer.size(), 0});
+        buffer.append(4, '\0');
+    }
+
+    void end() {
+        const Container& container = containers.back();
+        for(int i = 0; i < 4; i++){
+            buffer[container.offset + i] = static_cast<char>((container.count >> (24 - 8 * i)) & 0xff);
+        }
+        containers.pop_back();
+    }
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Results of a batch conversion: the outputs of all the messages are laid
+// out one after the other in a single buffer, with an entry per message
+// giving where its output is. A message that could not be converted has
+// the error message as output and is not 'ok'; the rest of the batch is
+// converted anyway. A message left out by a filter has an empty output and
+// is neither 'ok' nor an error.
+class OutputSink {
+
+public:
+    struct Entry {
+        size_t offset;
+        size_t length;
+        unsigned int bitLength;     // of an encoded message
+        bool ok;
+        bool filtered;
+    };
+
+    // Drop the content but keep the capacity
+    void clear() {
+        buffer.clear();
+        entries.clear();
+        filteredCount = 0;
+    }
+
+    // Room for 'messages' more outputs taking 'bytes' more bytes
+    void reserve(size_t messages, size_t bytes) {
+        if(entries.size() + messages > entries.capacity()){
+            entries.reserve(std::max(entries.size() + messages, entries.capacity() * 2));
+        }
+        if(buffer.size() + bytes > buffer.capacity()){
+            buffer.reserve(std::max(buffer.size() + bytes, buffer.capacity() * 2));
+        }
+    }
+
+    void append(const char* data, size_t length, unsigned int bitLength = 0) {
+        entries.push_back(Entry{buffer.size(), length, bitLength, true, false});
+        buffer.append(data, length);
+    }
+
+    void appendError(const std::string& message) {
+        entries.push_back(Entry{buffer.size(), message.size(), 0, false, false});
+        buffer += message;
+    }
+
+    void appendFiltered() {
+        entries.push_back(Entry{buffer.size(), 0, 0, false, true});
+        filteredCount++;
+    }
+
+    // Outputs of another sink, after the ones already here
+    void append(const OutputSink& other) {
+        size_t base = buffer.size();
+        reserve(other.entries.size(), other.buffer.size());
+        buffer += other.buffer;
+        for(Entry entry : other.entries){
+            entry.offset += base;
+            entries.push_back(entry);
+        }
+        filteredCount += other.filteredCount;
+    }
+
+    size_t size() const {return entries.size();}
+    const Entry& entry(size_t index) const {return entries[index];}
+    bool ok(size_t index) const {return entries[index].ok;}
+    bool filtered(size_t index) const {return entries[index].filtered;}
+    // Messages left out by the filter
+    size_t filtered() const {return filteredCount;}
+    unsigned int bitLength(size_t index) const {return entries[index].bitLength;}
+
+    // JSON or bytes of the message, or its error message
+    std::string_view output(size_t index) const {
+        return std::string_view(buffer.data() + entries[index].offset, entries[index].length);
+    }
+
+    const std::string& data() const {return buffer;}
+
+private:
+    std::string buffer;
+    std::vector<Entry> entries;
+    size_t filteredCount = 0;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// Immutable map from routing key to target (an instruction or a field
+// index), built once per routing element. Small key ranges, like a flag or
+// the digits of an ISO8583 MTI, become a dense array indexed by the key;
+// sparse keys go to a perfect hash table. Either way a lookup is one
+// indexed load and one compare.
+class RoutingTable {
+
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    RoutingTable() {}
+
+    explicit RoutingTable(const std::vector<std::pair<int, uint32_t>>& entries) {
+        if(entries.empty()){ return; }
+        int64_t minimum = entries[0].first;
+        int64_t maximum = entries[0].first;
+        for(const auto& entry : entries){
+            minimum = std::min<int64_t>(minimum, entry.first);
+            maximum = std::max<int64_t>(maximum, entry.first);
+        }
+        uint64_t range = static_cast<uint64_t>(maximum - minimum) + 1;
+        if(range <= 64 || range <= 4 * entries.size()){
+            dense = true;
+            base = minimum;
+            targets.assign(range, npos);
+            for(const auto& entry : entries){
+                targets[static_cast<uint64_t>(entry.first - base)] = entry.second;
+            }
+            return;
+        }
+        buildHash(entries);
+    }
+
+    uint32_t find(int key) const {
+        if(dense){
+            uint64_t index = static_cast<uint64_t>(static_cast<int64_t>(key) - base);
+            return index < targets.size() ? targets[index] : npos;
+        }
+        if(targets.empty()){ return npos; }
+        size_t index = slot(key);
+        return keys[index] == key ? targets[index] : npos;
+    }
+
+    bool isDense() const {return dense;}
+
+    // Entries ordered by key for a dense table, by slot otherwise
+    std::vector<std::pair<int, uint32_t>> entries() const {
+        std::vector<std::pair<int, uint32_t>> result;
+        for(size_t i = 0; i < targets.size(); i++){
+            if(targets[i] != npos){
+                result.emplace_back(dense ? static_cast<int>(base + static_cast<int64_t>(i)) : keys[i], targets[i]);
+            }
+        }
+        return result;
+    }
+
+    const std::string toString() const {
+        std::ostringstream oss;
+        oss << (dense ? "dense" : "hash") << "[" << targets.size() << "]";
+        for(const auto& [key, target] : entries()){
+            oss << " " << key << "->" << target;
+        }
+        return oss.str();
+    }
+
+private:
+    bool dense = false;
+    int64_t base = 0;               // dense: key of targets[0]
+    uint64_t multiplier = 0;        // hash: multiplicative hash parameters
+    unsigned int shift = 0;
+    std::vector<int> keys;          // hash: key stored in each slot
+    std::vector<uint32_t> targets;
+
+    size_t slot(int key) const {
+        return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(key)) * multiplier) >> shift);
+    }
+
+    // Look for a multiplier that maps every key to a distinct slot, doubling
+    // the table after a number of failed attempts
+    void buildHash(const std::vector<std::pair<int, uint32_t>>& entries) {
+        unsigned int bits = 1;
+        while((size_t(1) << bits) < 2 * entries.size()){ bits++; }
+        uint64_t state = 0x9e3779b97f4a7c15ULL;
+        for(;; bits++){
+            size_t size = size_t(1) << bits;
+            shift = 64 - bits;
+            for(int attempt = 0; attempt < 256; attempt++){
+                // splitmix64, forced odd
+                state += 0x9e3779b97f4a7c15ULL;
+                uint64_t z = state;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                multiplier = (z ^ (z >> 31)) | 1;
+
+                keys.assign(size, 0);
+                targets.assign(size, npos);
+                bool collision = false;
+                for(const auto& entry : entries){
+                    size_t index = slot(entry.first);
+                    if(targets[index] != npos){
+                        collision = true;
+                        break;
+                    }
+                    keys[index] = entry.first;
+                    targets[index] = entry.second;
+                }
+                if(not collision){ return; }
+            }
+        }
+    }
+};
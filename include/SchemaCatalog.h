@@ -7,10 +7,15 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <nlohmann/json.hpp>
 
 #include "Logger.h"
 #include "MessageElement.h"
+#include "FieldTable.h"
+#include "SchemaProgram.h"
+#include "GeneratedCodec.h"
+#include "Framing.h"
 
 using json = nlohmann::ordered_json;
 
@@ -20,6 +25,12 @@ struct Schema{
     std::string version;
     std::map<std::string, std::string> metadata;
     std::vector<MessageElement> structure;
+    size_t bitLengthHint = 0;   // expected size of an encoded message, used to presize the output
+    std::shared_ptr<const FieldTable> fields;       // immutable copy of 'structure' used at run time
+    std::shared_ptr<const SchemaProgram> program;   // decode program compiled from 'fields'
+    uint64_t fingerprint = 0;                       // see GeneratedCodec::fingerprintOf()
+    const GeneratedCodec* generated = nullptr;      // preferred over the interpreter when set
+    Framing framing;                                // end of a message in a stream
 };
 
 class SchemaCatalog {
@@ -27,11 +38,20 @@ private:
     SchemaCatalog(){};
     std::map<std::string, std::pair<std::map<std::string,std::string>,std::vector<MessageElement>>> configMap;
     std::map<std::string, Schema> schemaMap;
+    std::map<std::string, const GeneratedCodec*> generatedCodecs;
+    // Projections requested so far, by schema name and pointers
+    std::map<std::string, std::shared_ptr<const SchemaProgram>> projections;
+    std::mutex projectionsMutex;
+    static constexpr size_t maxProjections = 256;
 
     std::vector<MessageElementExistingCondition> parseJsonMessageElementExistingConditions(json);
     MessageElement parseJsonMessageElement(json, const json&);
     std::vector<MessageElement> parseJsonMessageElementStructure(json, const json&);
     std::map<int, MessageElement> parseJsonMessageElementRouting(json, const json&);
+    size_t estimateBitLength(const std::vector<MessageElement>&);
+    size_t estimateBitLength(const MessageElement&);
+    Framing parseJsonFraming(json, const SchemaProgram&, const std::string&);
+    void attachGeneratedCodec(Schema&);
 
 public:
     static SchemaCatalog& getInstance() {
@@ -42,6 +62,9 @@ public:
     void operator=(SchemaCatalog const&) = delete;
     std::map<std::string, Schema> addConfiguration(const std::string&, const std::string&);
     Schema* getSchema(const std::string&);
+    std::shared_ptr<const SchemaProgram> getProjection(const std::string&, const std::vector<std::string>&,
+                                                       const std::vector<std::string>& needed = {});
+    bool registerGeneratedCodec(const GeneratedCodec*);
     static std::string printMessageElementList(const std::vector<MessageElement>&);
 };
 
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include "MessageElement.h"
+#include "FieldTable.h"
+#include "JsonWriter.h"
+#include "CborWriter.h"
+#include "MsgPackWriter.h"
+#include "RoutingTable.h"
+
+
+// One step of a compiled schema. The schema tree is flattened once, when the
+// catalog is loaded, into a linear sequence of instructions executed by the
+// Engine for every message: arrays become loops, routing becomes a branch and
+// existing conditions a guarded skip over the element they apply to.
+struct Instruction {
+    enum class OpCode {
+        OP_FIELD,       // read a field and store it under its path
+        OP_EXTEND,      // read bits that extend a field already read
+        OP_SKIP,        // move past a field whose value is not needed (see project())
+        OP_ROUTE,       // branch on the value of the last field read
+        OP_LOOP,        // start of a repeated block
+        OP_NEXT,        // end of a repeated block: next iteration or exit
+        OP_CONDITION,   // skip a block when its existing conditions are not met
+        OP_BLOCK,       // fields of fixed position that follow, read all at once (see findFixedBlocks())
+        OP_JUMP,
+        OP_END
+    };
+
+    OpCode op;
+    MessageElement::MessageElementType type = MessageElement::MessageElementType::MET_UNDEFINED;
+    MessageElement::NumericEncodingType encoding = MessageElement::NumericEncodingType::NE_BINARY;
+    bool visible = true;
+    bool delimited = false;
+    uint32_t bitLength = 0;
+    int delimiter = 0;
+    int repetitions = 0;      // OP_LOOP: count, -1 up to the end of the stream, 0 taken from 'reference'
+    uint32_t jump = 0;        // OP_LOOP/OP_CONDITION/OP_BLOCK: first instruction after the block
+                              // OP_NEXT: the matching OP_LOOP, OP_ROUTE/OP_JUMP/OP_SKIP: where to continue
+    uint32_t table = 0;       // OP_ROUTE: routing table, OP_CONDITION: condition set, OP_BLOCK: layout
+    uint32_t path = 0;        // OP_FIELD/OP_EXTEND/OP_SKIP: path of the field, OP_LOOP: path of its items
+    uint32_t reference = 0;   // OP_LOOP: path holding the repetitions, OP_EXTEND: path of the extended field
+    uint32_t reg = noRegister;  // OP_FIELD: register keeping the value, if it is needed later
+                                // OP_LOOP/OP_EXTEND: register of 'reference'
+
+    static constexpr uint32_t noRegister = UINT32_MAX;
+
+    Instruction(OpCode op_) : op(op_) {}
+};
+
+// Step of a path in the decoded JSON: an object key or the index of one of
+// the enclosing arrays
+struct PathSegment {
+    bool index;
+    uint32_t id;        // index: nesting level of the array, key: entry in SchemaProgram::keys
+};
+
+// Path of a field in the decoded JSON, with a hole for the index of every
+// enclosing array: "/data/*" is the key "data" followed by the first index.
+struct FieldPath {
+    std::string pointer;                // printable form, '*' in place of the indices
+    std::vector<PathSegment> segments;
+    uint32_t arrays = 0;                // number of index segments
+};
+
+// Fields of an OP_BLOCK still to be decoded (not skipped by a projection),
+// with their position in bits from the start of the block
+struct FixedBlock {
+    std::vector<uint32_t> fields;       // instructions
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> bitLengths;
+};
+
+struct CompiledCondition {
+    uint32_t path;      // referenced field
+    uint32_t reg;
+    ConditionPredicate predicate;
+};
+
+class SchemaProgram {
+public:
+    std::vector<Instruction> code;
+    std::vector<FieldPath> paths;                       // indexed by path ID
+    std::vector<std::string> names;                     // object keys, as in the documents
+    std::vector<std::string> keys;                      // the same keys rendered as "name":
+    std::vector<std::string> cborKeys;                  // the same keys in CBOR and MessagePack
+    std::vector<std::string> msgpackKeys;
+    std::vector<RoutingTable> routingTables;            // routing key -> first instruction of the target
+    std::vector<std::vector<CompiledCondition>> conditions;
+    std::vector<FixedBlock> blocks;
+    uint32_t registerCount = 0;
+
+    static std::shared_ptr<const SchemaProgram> compile(const FieldTable&);
+    // Fields whose value is a plain extract of at most 64 bits
+    static bool fixedField(const Instruction&);
+
+    size_t fixedBitLength() const;
+    bool fixedPosition(const std::string&, size_t&, uint32_t&) const;
+    std::shared_ptr<const SchemaProgram> project(const std::vector<std::string>&, const std::vector<std::string>& needed = {}) const;
+
+    std::string toString() const;
+
+private:
+    std::vector<std::string> context;   // path parts of the element being compiled
+    std::unordered_map<std::string, uint32_t> pathIndex;
+    std::unordered_map<std::string, uint32_t> keyIndex;
+
+    void compileStructure(const FieldTable&, uint32_t, uint32_t);
+    void compileElement(const FieldTable&, const FieldDescriptor&, bool);
+    void compileField(const FieldTable&, const FieldDescriptor&, const std::string&);
+    uint32_t internPath(const std::string&);
+    uint32_t resolvePath(const std::string&);
+    uint32_t addPath(const std::string&);
+    uint32_t emit(Instruction);
+    void allocateRegisters();
+    void findFixedBlocks();
+    std::vector<bool> jumpTargets() const;
+    std::vector<uint32_t> countWrites(uint32_t, uint32_t) const;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+
+// Non-owning view over contiguous elements, in place of C++20 std::span
+template<typename T>
+class Span {
+
+public:
+    Span() : items(nullptr), count(0) {}
+    Span(T* items_, size_t count_) : items(items_), count(count_) {}
+
+    template<typename U>
+    Span(std::vector<U>& vector) : items(vector.data()), count(vector.size()) {}
+
+    template<typename U>
+    Span(const std::vector<U>& vector) : items(vector.data()), count(vector.size()) {}
+
+    T* begin() const {return items;}
+    T* end() const {return items + count;}
+    T& operator[](size_t index) const {return items[index];}
+    size_t size() const {return count;}
+    bool empty() const {return count == 0;}
+
+    Span subspan(size_t offset, size_t count_) const {
+        return Span(items + offset, count_);
+    }
+
+private:
+    T* items;
+    size_t count;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+#include "BitView.h"
+#include "Framing.h"
+#include "SchemaCatalog.h"
+
+
+// Splits a continuous stream of back-to-back messages of one schema (a file,
+// a pipe, a socket) into messages, following the framing of the schema. The
+// input goes through a buffer of fixed capacity: a message is handed out as
+// a view of the buffer, without copying, and the buffer is reused once the
+// messages before the partial one at its end have been handed out, so an
+// endless feed runs in constant memory.
+class StreamDecoder {
+
+public:
+    // Read at most 'size' bytes into 'buffer'; 0 at the end of the stream
+    using Source = std::function<size_t(unsigned char* buffer, size_t size)>;
+
+    // Partial reads are returned as they come, as needed for pipes and sockets
+    static Source fromDescriptor(int);
+    // Blocks until the buffer is full or the stream ends: fit for files
+    static Source fromStream(std::istream&);
+
+    static constexpr size_t defaultCapacity = 1 << 20;
+
+    // The capacity bounds the size of a message
+    StreamDecoder(const Schema&, Source, size_t capacity = defaultCapacity);
+
+    // Next message, valid until the next call; false at the end of the stream
+    bool next(BitView&);
+    // As many messages as already in the buffer (at least one, unless the
+    // stream has ended) up to 'maxMessages', valid until the next call
+    size_t nextBatch(std::vector<BitView>&, size_t maxMessages);
+
+    size_t getMessages() const {return messages;}
+
+private:
+    std::string schemaName;
+    Framing framing;
+    Source source;
+    std::vector<unsigned char> buffer;
+    size_t begin = 0;       // first byte not handed out
+    size_t end = 0;         // end of the bytes read
+    size_t scanned = 0;     // see Framing::frameLength()
+    size_t messages = 0;
+    bool finished = false;
+
+    bool frame(BitView&);
+    bool fill();
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of worker threads, each with its own task deque: a worker runs
+// the newest task of its own deque and, when it is empty, steals the oldest
+// task of another one. Tasks submitted by a worker go to its own deque,
+// tasks submitted from outside are spread over all of them.
+class ThreadPool {
+
+public:
+    // 'threads' set to 0 uses one thread per core. With 'pinned' each worker
+    // is bound to a single core.
+    explicit ThreadPool(size_t threads = 0, bool pinned = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const {return workers.size();}
+
+    void submit(std::function<void()> task);
+
+    // Run 'body' on consecutive ranges of [0, count) of at most 'grain'
+    // items, the calling thread taking part, and return when all of them are
+    // done. The first exception thrown by 'body' is rethrown.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> pending{0};     // tasks queued, not yet started
+    std::atomic<size_t> next{0};        // deque of the next external submit
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    void run(size_t index, bool pinned);
+    bool runOne(size_t index);
+    bool take(size_t index, bool newest, std::function<void()>& task);
+    size_t current() const;
+};
@@ -0,0 +1,259 @@
+#include "Base64.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr const char base64_chars[64] = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
+    'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
+    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
+    'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'
+};
+
+// Reverse alphabet: sextet value for every valid character, 0xff otherwise
+struct DecodeTable {
+    uint8_t value[256];
+    constexpr DecodeTable() : value() {
+        for(int i = 0; i < 256; i++){ value[i] = 0xff; }
+        for(int i = 0; i < 64; i++){ value[static_cast<unsigned char>(base64_chars[i])] = static_cast<uint8_t>(i); }
+    }
+};
+constexpr DecodeTable decode_table;
+
+// Scalar decoder for the tail of the input (or for the whole input when no
+// vector kernel is available). Returns the number of bytes written.
+size_t decodeScalar(const char* src, size_t length, unsigned char* dst) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+    unsigned char* out = dst;
+    size_t i = 0;
+    for(; i + 4 <= length; i += 4){
+        uint32_t a = decode_table.value[in[i]];
+        uint32_t b = decode_table.value[in[i + 1]];
+        uint32_t c = decode_table.value[in[i + 2]];
+        uint32_t d = decode_table.value[in[i + 3]];
+        if((a | b | c | d) & 0x80){ break; }
+        uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = static_cast<unsigned char>(triple >> 16);
+        out[1] = static_cast<unsigned char>(triple >> 8);
+        out[2] = static_cast<unsigned char>(triple);
+        out += 3;
+    }
+    // Last (partial) quadruple: 'n' valid characters produce n-1 bytes
+    uint32_t sextets[4] = {0, 0, 0, 0};
+    size_t n = 0;
+    while(n < 4 && i + n < length && !(decode_table.value[in[i + n]] & 0x80)){
+        sextets[n] = decode_table.value[in[i + n]];
+        n++;
+    }
+    if(n > 1){
+        uint32_t triple = (sextets[0] << 18) | (sextets[1] << 12) | (sextets[2] << 6) | sextets[3];
+        for(size_t k = 0; k < n - 1; k++){
+            out[k] = static_cast<unsigned char>(triple >> (16 - 8 * k));
+        }
+        out += n - 1;
+    }
+    return static_cast<size_t>(out - dst);
+}
+
+void encodeScalar(const unsigned char* src, size_t length, char* dst) {
+    size_t i = 0;
+    for(; i + 3 <= length; i += 3){
+        uint32_t triple = (static_cast<uint32_t>(src[i]) << 16) | (static_cast<uint32_t>(src[i + 1]) << 8) | src[i + 2];
+        dst[0] = base64_chars[(triple >> 18) & 0x3f];
+        dst[1] = base64_chars[(triple >> 12) & 0x3f];
+        dst[2] = base64_chars[(triple >> 6) & 0x3f];
+        dst[3] = base64_chars[triple & 0x3f];
+        dst += 4;
+    }
+    if(i < length){
+        uint32_t triple = static_cast<uint32_t>(src[i]) << 16;
+        if(i + 1 < length){ triple |= static_cast<uint32_t>(src[i + 1]) << 8; }
+        dst[0] = base64_chars[(triple >> 18) & 0x3f];
+        dst[1] = base64_chars[(triple >> 12) & 0x3f];
+        dst[2] = i + 1 < length ? base64_chars[(triple >> 6) & 0x3f] : '=';
+        dst[3] = '=';
+    }
+}
+
+#ifdef BASE64_X86
+
+// Vector kernels after W. Mula and D. Lemire, "Faster Base64 Encoding and
+// Decoding Using AVX2 Instructions". Characters are classified and translated
+// with pshufb lookups keyed by their high nibble; any block containing a
+// padding or invalid character is left to the scalar decoder.
+
+__attribute__((target("ssse3")))
+size_t decodeSSSE3(const char* src, size_t length, unsigned char* dst) {
+    const __m128i lower_bound_lut = _mm_setr_epi8(1, 1, 0x2b, 0x30, 0x41, 0x50, 0x61, 0x70, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i upper_bound_lut = _mm_setr_epi8(0, 0, 0x2b, 0x39, 0x4f, 0x5a, 0x6f, 0x7a, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i shift_lut = _mm_setr_epi8(0, 0, 0x3e - 0x2b, 0x34 - 0x30, 0x00 - 0x41, 0x0f - 0x50, 0x1a - 0x61, 0x29 - 0x70,
+                                            0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack_shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0;
+    unsigned char* out = dst;
+    for(; i + 16 <= length; i += 16){
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i higher_nibble = _mm_and_si128(_mm_srli_epi32(input, 4), _mm_set1_epi8(0x0f));
+        const __m128i below = _mm_cmplt_epi8(input, _mm_shuffle_epi8(lower_bound_lut, higher_nibble));
+        const __m128i above = _mm_cmpgt_epi8(input, _mm_shuffle_epi8(upper_bound_lut, higher_nibble));
+        const __m128i eq_2f = _mm_cmpeq_epi8(input, _mm_set1_epi8(0x2f));
+        const __m128i outside = _mm_andnot_si128(eq_2f, _mm_or_si128(below, above));
+        if(_mm_movemask_epi8(outside)){ break; }
+        __m128i values = _mm_add_epi8(input, _mm_shuffle_epi8(shift_lut, higher_nibble));
+        values = _mm_add_epi8(values, _mm_and_si128(eq_2f, _mm_set1_epi8(-3)));
+        // Merge the sextets: 4 x 6 bits -> 3 bytes per 32-bit lane
+        const __m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140)),
+                                              _mm_set1_epi32(0x00011000));
+        unsigned char packed[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packed), _mm_shuffle_epi8(merged, pack_shuffle));
+        std::memcpy(out, packed, 12);
+        out += 12;
+    }
+    return static_cast<size_t>(out - dst) + decodeScalar(src + i, length - i, out);
+}
+
+__attribute__((target("avx2")))
+size_t decodeAVX2(const char* src, size_t length, unsigned char* dst) {
+    const __m256i lower_bound_lut = _mm256_setr_epi8(1, 1, 0x2b, 0x30, 0x41, 0x50, 0x61, 0x70, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                     1, 1, 0x2b, 0x30, 0x41, 0x50, 0x61, 0x70, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m256i upper_bound_lut = _mm256_setr_epi8(0, 0, 0x2b, 0x39, 0x4f, 0x5a, 0x6f, 0x7a, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                     0, 0, 0x2b, 0x39, 0x4f, 0x5a, 0x6f, 0x7a, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i shift_lut = _mm256_setr_epi8(0, 0, 0x3e - 0x2b, 0x34 - 0x30, 0x00 - 0x41, 0x0f - 0x50, 0x1a - 0x61, 0x29 - 0x70,
+                                               0, 0, 0, 0, 0, 0, 0, 0,
+                                               0, 0, 0x3e - 0x2b, 0x34 - 0x30, 0x00 - 0x41, 0x0f - 0x50, 0x1a - 0x61, 0x29 - 0x70,
+                                               0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack_shuffle = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                  2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i pack_permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    size_t i = 0;
+    unsigned char* out = dst;
+    for(; i + 32 <= length; i += 32){
+        const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const __m256i higher_nibble = _mm256_and_si256(_mm256_srli_epi32(input, 4), _mm256_set1_epi8(0x0f));
+        const __m256i below = _mm256_cmpgt_epi8(_mm256_shuffle_epi8(lower_bound_lut, higher_nibble), input);
+        const __m256i above = _mm256_cmpgt_epi8(input, _mm256_shuffle_epi8(upper_bound_lut, higher_nibble));
+        const __m256i eq_2f = _mm256_cmpeq_epi8(input, _mm256_set1_epi8(0x2f));
+        const __m256i outside = _mm256_andnot_si256(eq_2f, _mm256_or_si256(below, above));
+        if(_mm256_movemask_epi8(outside)){ break; }
+        __m256i values = _mm256_add_epi8(input, _mm256_shuffle_epi8(shift_lut, higher_nibble));
+        values = _mm256_add_epi8(values, _mm256_and_si256(eq_2f, _mm256_set1_epi8(-3)));
+        const __m256i merged = _mm256_madd_epi16(_mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140)),
+                                                 _mm256_set1_epi32(0x00011000));
+        const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(merged, pack_shuffle), pack_permute);
+        unsigned char bytes[32];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes), packed);
+        std::memcpy(out, bytes, 24);
+        out += 24;
+    }
+    // The SSSE3 tail is legacy SSE code: clear the upper halves first, the
+    // compiler does not on this path and every transition stalls otherwise
+    _mm256_zeroupper();
+    return static_cast<size_t>(out - dst) + decodeSSSE3(src + i, length - i, out);
+}
+
+// Translate 6-bit indices into the base64 alphabet
+__attribute__((target("ssse3")))
+inline __m128i encodeLookupSSSE3(const __m128i indices) {
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                            '/' - 63, 'A', 0, 0);
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, result), indices);
+}
+
+// Split 12 bytes (spread as b1 b0 b2 b1 in each 32-bit lane) into 16 indices
+__attribute__((target("ssse3")))
+inline __m128i encodeUnpackSSSE3(const __m128i input) {
+    const __m128i in = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t0, t1);
+}
+
+__attribute__((target("ssse3")))
+void encodeSSSE3(const unsigned char* src, size_t length, char* dst) {
+    size_t i = 0;
+    // Each step consumes 12 bytes but loads 16
+    for(; i + 16 <= length; i += 12){
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), encodeLookupSSSE3(encodeUnpackSSSE3(input)));
+        dst += 16;
+    }
+    encodeScalar(src + i, length - i, dst);
+}
+
+__attribute__((target("avx2")))
+void encodeAVX2(const unsigned char* src, size_t length, char* dst) {
+    const __m256i shift_lut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                               '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                               '/' - 63, 'A', 0, 0,
+                                               'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                               '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                               '/' - 63, 'A', 0, 0);
+    const __m256i spread = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                           10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    size_t i = 0;
+    // Each step consumes 24 bytes, the second lane loads up to byte 28
+    for(; i + 28 <= length; i += 24){
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 12));
+        const __m256i in = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), spread);
+        const __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        const __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t0, t1);
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, result), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), result);
+        dst += 32;
+    }
+    // As in decodeAVX2, before the SSSE3 tail
+    _mm256_zeroupper();
+    encodeSSSE3(src + i, length - i, dst);
+}
+
+#endif
+
+struct Kernels {
+    size_t (*decode)(const char*, size_t, unsigned char*);
+    void (*encode)(const unsigned char*, size_t, char*);
+    const char* name;
+};
+
+Kernels selectKernels() {
+#ifdef BASE64_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){ return {decodeAVX2, encodeAVX2, "avx2"}; }
+    if(__builtin_cpu_supports("ssse3")){ return {decodeSSSE3, encodeSSSE3, "ssse3"}; }
+#endif
+    return {decodeScalar, encodeScalar, "scalar"};
+}
+
+const Kernels& kernels() {
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+}
+
+size_t Base64::decode(const char* src, size_t length, unsigned char* dst) {
+    return kernels().decode(src, length, dst);
+}
+
+void Base64::encode(const unsigned char* src, size_t length, char* dst) {
+    kernels().encode(src, length, dst);
+}
+
+const char* Base64::implementation() {
+    return kernels().name;
+}
@@ -0,0 +1,677 @@
+#include "Codegen.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <stdexcept>
+
+// Bound on the code generated: routing continuations are duplicated in
+// every alternative
+static const size_t maxInstructions = 100000;
+
+Codegen::Codegen(const Schema& schema_):
+    schema(schema_), program(*schema_.program), table(*schema_.fields) {}
+
+std::string Codegen::generate(const Schema& schema){
+    Codegen generator(schema);
+    generator.validate();
+    std::string name = identifier(schema.catalogName);
+    std::ostringstream& out = generator.out;
+    out << "// Generated by openformat-codegen from the schema <" << schema.catalogName << ">: do not edit.\n";
+    out << "#pragma once\n\n";
+    out << "#include <cstring>\n";
+    out << "#include <string>\n";
+    out << "#include \"GeneratedCodec.h\"\n";
+    out << "#include \"Logger.h\"\n";
+    out << "#include \"SchemaCatalog.h\"\n\n";
+    out << "namespace openformat_generated {\n";
+    out << "namespace " << name << " {\n\n";
+    out << "inline const std::string keys[] = {";
+    for(size_t i = 0; i < generator.program.keys.size(); i++){
+        out << (i ? ", " : "") << quote(generator.program.keys[i]);
+    }
+    out << "};\n";
+    out << "inline const std::string noKey;\n\n";
+    generator.emitDecode();
+    generator.emitEncode();
+    out << "inline const GeneratedCodec codec{" << quote(schema.catalogName) << ", 0x" << std::hex << schema.fingerprint << std::dec
+        << "ULL, decode, encode};\n";
+    out << "inline const bool registered = SchemaCatalog::getInstance().registerGeneratedCodec(&codec);\n\n";
+    out << "}\n";
+    out << "}\n";
+    return out.str();
+}
+
+void Codegen::validate(){
+    for(uint32_t i = 0; i < table.rootCount; i++){
+        validateField(table.fields[i], false);
+    }
+    auto reject = [this](const std::string& what){
+        throw std::invalid_argument("Schema <" + schema.catalogName + ">: " + what + " not supported by the code generator");
+    };
+    for(size_t pc = 0; pc < program.code.size(); pc++){
+        const Instruction& instruction = program.code[pc];
+        switch(instruction.op){
+            case Instruction::OpCode::OP_FIELD:
+                if(program.paths[instruction.path].segments[0].index){
+                    reject("array at the root of the message");
+                }
+                break;
+            case Instruction::OpCode::OP_EXTEND:
+                if(instruction.bitLength >= 64 || program.paths[instruction.reference].arrays){
+                    reject("extension of <" + program.paths[instruction.reference].pointer + ">");
+                }
+                break;
+            case Instruction::OpCode::OP_LOOP:
+                if(program.code[pc + 1].op != Instruction::OpCode::OP_FIELD || program.code[pc + 2].op != Instruction::OpCode::OP_NEXT){
+                    reject("array of structures or routing inside an array");
+                }
+                if(instruction.repetitions == 0 && program.paths[instruction.reference].arrays){
+                    reject("repetitions taken from <" + program.paths[instruction.reference].pointer + ">");
+                }
+                break;
+            case Instruction::OpCode::OP_CONDITION:
+                reject("existing conditions are");
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void Codegen::validateField(const FieldDescriptor& field, bool inArray){
+    auto reject = [this, &field](const std::string& what){
+        throw std::invalid_argument("Field <" + table.name(field.name) + "> of schema <" + schema.catalogName + ">: " +
+                                    what + " not supported by the code generator");
+    };
+    if(field.conditionCount){
+        reject("existing conditions are");
+    }
+    if(field.type == MessageElement::MessageElementType::MET_STRUCTURE){
+        if(field.array){
+            reject("arrays of structures are");
+        }
+        for(uint32_t i = field.firstChild; i < field.firstChild + field.childCount; i++){
+            validateField(table.fields[i], inArray);
+        }
+        return;
+    }
+    if(field.delimited || field.bitLength == 0){
+        reject("delimited fields are");
+    }
+    bool numeric = field.type == MessageElement::MessageElementType::MET_INTEGER ||
+                   field.type == MessageElement::MessageElementType::MET_UNSIGNED_INTEGER ||
+                   field.type == MessageElement::MessageElementType::MET_BOOLEAN ||
+                   field.type == MessageElement::MessageElementType::MET_EXTENDED;
+    if(numeric && field.bitLength > 64){
+        reject("a length above 64 bits is");
+    }
+    if(field.encoding == MessageElement::NumericEncodingType::NE_BCD ||
+       field.encoding == MessageElement::NumericEncodingType::NE_ASCII){
+        reject("numbers written as BCD or ASCII digits are");
+    }
+    if(field.type == MessageElement::MessageElementType::MET_DECIMAL && field.bitLength != 32 && field.bitLength != 64){
+        reject("a decimal length other than 32 or 64 bits is");
+    }
+    if(field.routeCount && (field.array || inArray)){
+        reject("routing inside an array is");
+    }
+    for(uint32_t i = field.firstRoute; i < field.firstRoute + field.routeCount; i++){
+        validateField(table.fields[table.routes[i].field], inArray || field.array);
+    }
+}
+
+std::ostream& Codegen::line(int depth){
+    return out << std::string(4 * depth, ' ');
+}
+
+std::string Codegen::position(const DecodeState& state) const {
+    if(not state.dynamic){
+        return std::to_string(state.offset);
+    }
+    return state.offset ? "pos + " + std::to_string(state.offset) : "pos";
+}
+
+// Decoder: the program is run at generation time, following every routing
+// alternative, so the output structure and the bit offsets are constants
+void Codegen::emitDecode(){
+    out << "inline bool decode(const unsigned char* data, size_t bits, size_t bytes, JsonWriter& out){\n";
+    line(1) << "BitView in(data, 0, bits, bytes);\n";
+    line(1) << "[[maybe_unused]] size_t pos = 0;\n";
+    for(uint32_t k = 0; k < program.registerCount; k++){
+        line(1) << "[[maybe_unused]] uint64_t r" << k << " = 0, raw" << k << " = 0;\n";
+        line(1) << "[[maybe_unused]] size_t o" << k << " = 0, l" << k << " = 0;\n";
+    }
+    DecodeState state;
+    state.alternatives.push_back(Alternative{"", -1});
+    state.set.assign(program.registerCount, false);
+    state.written.assign(program.registerCount, false);
+    emitBlock(0, state, 1);
+    out << "}\n\n";
+}
+
+void Codegen::emitBlock(uint32_t pc, DecodeState state, int depth){
+    emitBoundsCheck(pc, state, depth);
+    while(true){
+        if(++emitted > maxInstructions){
+            throw std::invalid_argument("Schema <" + schema.catalogName + ">: too many routing alternatives for the code generator");
+        }
+        const Instruction& instruction = program.code[pc];
+        switch(instruction.op){
+            case Instruction::OpCode::OP_FIELD:
+                if(not emitField(pc, state, depth)){ return; }
+                pc++;
+                break;
+            case Instruction::OpCode::OP_EXTEND:
+                if(not emitExtend(pc, state, depth)){ return; }
+                pc++;
+                break;
+            case Instruction::OpCode::OP_ROUTE:
+                emitRoute(instruction, state, depth);
+                return;
+            case Instruction::OpCode::OP_LOOP:
+                if(not emitLoop(pc, state, depth)){ return; }
+                pc = instruction.jump;
+                emitBoundsCheck(pc, state, depth);
+                break;
+            case Instruction::OpCode::OP_JUMP:
+                pc = instruction.jump;
+                break;
+            case Instruction::OpCode::OP_BLOCK:
+                // Offsets are already resolved at generation time
+                pc++;
+                break;
+            case Instruction::OpCode::OP_END:
+                emitEnd(state, depth);
+                return;
+            default:
+                throw std::logic_error("Unexpected instruction in generated code");
+        }
+    }
+}
+
+// One check covers the fixed-size fields up to the next loop or routing
+void Codegen::emitBoundsCheck(uint32_t pc, const DecodeState& state, int depth){
+    size_t end = state.offset;
+    while(true){
+        const Instruction& instruction = program.code[pc];
+        if(instruction.op == Instruction::OpCode::OP_FIELD || instruction.op == Instruction::OpCode::OP_EXTEND){
+            end += instruction.bitLength;
+            pc++;
+        } else if(instruction.op == Instruction::OpCode::OP_JUMP){
+            pc = instruction.jump;
+        } else if(instruction.op == Instruction::OpCode::OP_BLOCK){
+            pc++;
+        } else {
+            break;
+        }
+    }
+    if(end > state.offset){
+        line(depth) << "if(" << (state.dynamic ? "pos + " : "") << end << " > bits){ return false; }\n";
+    }
+}
+
+bool Codegen::emitField(uint32_t pc, DecodeState& state, int depth){
+    const Instruction& instruction = program.code[pc];
+    std::string f = "f" + std::to_string(pc);
+    std::string view = "in.subView(" + position(state) + ", " + std::to_string(instruction.bitLength) + ")";
+    std::string read = "(" + position(state) + ", " + std::to_string(instruction.bitLength) + ")";
+    std::string value = "out.value(" + f + ");";
+    std::string retained;
+    std::string key = "0";
+    switch(instruction.type){
+        case MessageElement::MessageElementType::MET_INTEGER:
+            line(depth) << "int64_t " << f << " = in.readI64" << read << ";\n";
+            retained = "static_cast<uint64_t>(" + f + ")";
+            key = "static_cast<int>(" + f + ")";
+            break;
+        case MessageElement::MessageElementType::MET_UNSIGNED_INTEGER:
+            line(depth) << "uint64_t " << f << " = in.readU64" << read << ";\n";
+            retained = f;
+            key = "static_cast<int>(" + f + ")";
+            break;
+        case MessageElement::MessageElementType::MET_DECIMAL:
+            line(depth) << "double " << f << " = " << view << ".to_double(" << instruction.bitLength << ");\n";
+            break;
+        case MessageElement::MessageElementType::MET_BOOLEAN:
+            line(depth) << "bool " << f << " = " << view << ".to_boolean();\n";
+            retained = f + " ? 1 : 0";
+            break;
+        case MessageElement::MessageElementType::MET_STRING:
+            line(depth) << "BitView " << f << " = " << view << ";\n";
+            value = "if((" + f + ".getOffset() % 8) == 0 && (" + f + ".getLength() % 8) == 0){ out.value(reinterpret_cast<const char*>(" +
+                    f + ".getData() + (" + f + ".getOffset() >> 3)), " + f + ".getLengthInBytes()); } else { std::string text = " +
+                    f + ".to_string(); out.value(text.data(), text.size()); }";
+            break;
+        default:
+            line(depth) << "return false;\n";
+            return false;
+    }
+    if(instruction.reg != Instruction::noRegister){
+        std::string k = std::to_string(instruction.reg);
+        if(instruction.type == MessageElement::MessageElementType::MET_UNSIGNED_INTEGER){
+            line(depth) << "raw" << k << " = " << f << ";\n";
+        } else if(instruction.bitLength <= 64){
+            line(depth) << "raw" << k << " = in.readU64" << read << ";\n";
+        }
+        if(not retained.empty()){
+            line(depth) << "r" << k << " = " << retained << ";\n";
+        }
+        state.set[instruction.reg] = true;
+    }
+    if(instruction.visible){
+        emitWrite(instruction.path, instruction.reg, value, state, depth);
+    }
+    state.offset += instruction.bitLength;
+    state.key = key;
+    return true;
+}
+
+bool Codegen::emitExtend(uint32_t pc, DecodeState& state, int depth){
+    const Instruction& instruction = program.code[pc];
+    if(instruction.reg == Instruction::noRegister || not state.set[instruction.reg]){
+        line(depth) << "return false;\n";
+        return false;
+    }
+    std::string f = "f" + std::to_string(pc);
+    std::string k = std::to_string(instruction.reg);
+    line(depth) << "uint64_t " << f << " = (raw" << k << " << " << instruction.bitLength << ") | in.readU64(" << position(state)
+                << ", " << instruction.bitLength << ");\n";
+    line(depth) << "r" << k << " = " << f << ";\n";
+    if(instruction.visible){
+        emitWrite(instruction.reference, instruction.reg, "out.value(" + f + ");", state, depth);
+    }
+    state.offset += instruction.bitLength;
+    state.key = "static_cast<int>(" + f + ")";
+    return true;
+}
+
+// Arrays of fields: the first item follows whatever was written before,
+// the next ones the previous item
+bool Codegen::emitLoop(uint32_t pc, DecodeState& state, int depth){
+    const Instruction& loop = program.code[pc];
+    const Instruction& field = program.code[pc + 1];
+    if(not state.dynamic){
+        line(depth) << "pos = " << state.offset << ";\n";
+    } else if(state.offset){
+        line(depth) << "pos += " << state.offset << ";\n";
+    }
+    state.dynamic = true;
+    state.offset = 0;
+
+    std::string n = "n" + std::to_string(pc);
+    std::string i = "i" + std::to_string(pc);
+    std::string count = std::to_string(loop.repetitions);
+    if(loop.repetitions == 0){
+        if(not state.set[loop.reg]){
+            line(depth) << "return false;\n";
+            return false;
+        }
+        count = "static_cast<int>(r" + std::to_string(loop.reg) + ")";
+    }
+    line(depth) << "int " << n << " = " << count << ";\n";
+    line(depth) << "if(" << n << " != 0){\n";
+    line(depth + 1) << "for(uint32_t " << i << " = 0;;){\n";
+    line(depth + 2) << "if(pos + " << field.bitLength << " > bits){ return false; }\n";
+    DecodeState item = state;
+    item.item = i;
+    emitField(pc + 1, item, depth + 2);
+    line(depth + 2) << "pos += " << field.bitLength << ";\n";
+    line(depth + 2) << "++" << i << ";\n";
+    line(depth + 2) << "if(not ((" << n << " == -1 || " << i << " < static_cast<uint32_t>(" << n << ")) && pos + 1 < bits)){ break; }\n";
+    line(depth + 1) << "}\n";
+    line(depth) << "}\n";
+
+    if(field.visible){
+        std::vector<Alternative> alternatives;
+        for(const auto& alternative : state.alternatives){
+            std::string condition = n + " == 0";
+            if(not alternative.condition.empty()){
+                condition += " && " + alternative.condition;
+            }
+            alternatives.push_back(Alternative{condition, alternative.path});
+        }
+        alternatives.push_back(Alternative{n + " != 0", field.path});
+        state.alternatives = std::move(alternatives);
+    }
+    return true;
+}
+
+// Each alternative is generated with its own copy of the rest of the program
+void Codegen::emitRoute(const Instruction& instruction, const DecodeState& state, int depth){
+    auto entries = program.routingTables[instruction.table].entries();
+    std::sort(entries.begin(), entries.end());
+    line(depth) << "switch(" << state.key << "){\n";
+    for(const auto& [key, target] : entries){
+        line(depth) << "case " << key << ": {\n";
+        emitBlock(target, state, depth + 1);
+        line(depth) << "}\n";
+    }
+    line(depth) << "default:\n";
+    line(depth + 1) << "return false;\n";
+    line(depth) << "}\n";
+}
+
+// Same bookkeeping as Engine::beginValue() and Engine::endValue(), resolved
+// at generation time
+void Codegen::emitWrite(uint32_t path, uint32_t reg, const std::string& value, DecodeState& state, int depth){
+    bool tracked = reg != Instruction::noRegister && program.paths[path].arrays == 0;
+    if(tracked && state.written[reg]){
+        std::string k = std::to_string(reg);
+        line(depth) << "{\n";
+        line(depth + 1) << "size_t start = out.size();\n";
+        line(depth + 1) << value << "\n";
+        line(depth + 1) << "std::string text = out.str().substr(start);\n";
+        line(depth + 1) << "out.truncate(start);\n";
+        line(depth + 1) << "out.replace(o" << k << ", l" << k << ", text);\n";
+        for(uint32_t j = 0; j < program.registerCount; j++){
+            if(j != reg && state.written[j]){
+                line(depth + 1) << "if(o" << j << " > o" << k << "){ o" << j << " = o" << j << " + text.size() - l" << k << "; }\n";
+            }
+        }
+        line(depth + 1) << "l" << k << " = text.size();\n";
+        line(depth) << "}\n";
+        return;
+    }
+    emitTransition(state, path, depth);
+    if(tracked){
+        std::string k = std::to_string(reg);
+        line(depth) << "o" << k << " = out.size();\n";
+        line(depth) << value << "\n";
+        line(depth) << "l" << k << " = out.size() - o" << k << ";\n";
+        state.written[reg] = true;
+    } else {
+        line(depth) << value << "\n";
+    }
+}
+
+void Codegen::emitTransition(DecodeState& state, uint32_t path, int depth){
+    int inner = depth;
+    if(not state.item.empty()){
+        line(depth) << "if(" << state.item << " == 0){\n";
+        inner++;
+    }
+    if(state.alternatives.size() == 1){
+        emitTransitionFrom(state.alternatives[0].path, path, inner);
+    } else {
+        for(size_t i = 0; i < state.alternatives.size(); i++){
+            if(i == 0){
+                line(inner) << "if(" << state.alternatives[i].condition << "){\n";
+            } else if(i + 1 < state.alternatives.size()){
+                line(inner) << "} else if(" << state.alternatives[i].condition << "){\n";
+            } else {
+                line(inner) << "} else {\n";
+            }
+            emitTransitionFrom(state.alternatives[i].path, path, inner + 1);
+        }
+        line(inner) << "}\n";
+    }
+    if(not state.item.empty()){
+        line(depth) << "} else {\n";
+        line(depth + 1) << "out.member(noKey);\n";
+        line(depth) << "}\n";
+    }
+    state.alternatives.assign(1, Alternative{"", path});
+}
+
+// Containers to close and to open going from the member 'last' to 'path',
+// as Engine::openMember() does at run time
+void Codegen::emitTransitionFrom(int64_t last, uint32_t path, int depth){
+    const std::vector<PathSegment>& to = program.paths[path].segments;
+    size_t depthTo = to.size() - 1;
+    std::vector<PathSegment> from;
+    size_t depthFrom = 0;
+    if(last < 0){
+        line(depth) << "out.beginObject();\n";
+    } else {
+        from = program.paths[last].segments;
+        depthFrom = from.size() - 1;
+    }
+    size_t common = 0;
+    while(common < depthFrom && common < depthTo && not from[common].index &&
+          from[common].index == to[common].index && from[common].id == to[common].id){
+        common++;
+    }
+    for(size_t i = depthFrom; i > common; i--){
+        line(depth) << (from[i].index ? "out.endArray();\n" : "out.endObject();\n");
+    }
+    for(size_t i = common; i < depthTo; i++){
+        line(depth) << "out.member(keys[" << to[i].id << "]);\n";
+        line(depth) << (to[i + 1].index ? "out.beginArray();\n" : "out.beginObject();\n");
+    }
+    if(to[depthTo].index){
+        line(depth) << "out.member(noKey);\n";
+    } else {
+        line(depth) << "out.member(keys[" << to[depthTo].id << "]);\n";
+    }
+}
+
+void Codegen::emitEnd(const DecodeState& state, int depth){
+    std::string end = position(state);
+    line(depth) << "if(" << end << " < bits){\n";
+    line(depth + 1) << "Logger::getInstance().log(\"Remaining unprocessed bits in the bit stream: \" + std::to_string(bits - (" << end
+                    << ")) + \" bit(s) left\", Logger::Level::WARNING);\n";
+    line(depth) << "}\n";
+    for(size_t a = 0; a < state.alternatives.size(); a++){
+        int inner = depth;
+        if(state.alternatives.size() > 1){
+            if(a == 0){
+                line(depth) << "if(" << state.alternatives[a].condition << "){\n";
+            } else if(a + 1 < state.alternatives.size()){
+                line(depth) << "} else if(" << state.alternatives[a].condition << "){\n";
+            } else {
+                line(depth) << "} else {\n";
+            }
+            inner++;
+        }
+        int64_t last = state.alternatives[a].path;
+        if(last < 0){
+            line(inner) << "out.beginObject();\n";
+        } else {
+            const std::vector<PathSegment>& from = program.paths[last].segments;
+            for(size_t i = from.size() - 1; i > 0; i--){
+                line(inner) << (from[i].index ? "out.endArray();\n" : "out.endObject();\n");
+            }
+        }
+        line(inner) << "out.endObject();\n";
+    }
+    if(state.alternatives.size() > 1){
+        line(depth) << "}\n";
+    }
+    line(depth) << "return true;\n";
+}
+
+// Encoder: the same walk as Engine::analizeJsonStructure(), with the
+// lookups in the input resolved to member accesses
+void Codegen::emitEncode(){
+    out << "inline bool encode(const nlohmann::ordered_json& input, BitWriter& out){\n";
+    if(emitEncodeStructure(0, table.rootCount, {}, 1)){
+        line(1) << "return true;\n";
+    }
+    out << "}\n\n";
+}
+
+bool Codegen::emitEncodeStructure(uint32_t first, uint32_t count, const std::vector<PathPart>& parts, int depth){
+    for(uint32_t i = first; i < first + count; i++){
+        const FieldDescriptor& field = table.fields[i];
+        std::vector<PathPart> path = parts;
+        if(field.type == MessageElement::MessageElementType::MET_STRUCTURE){
+            if(not field.flatten){
+                path.push_back(PathPart{false, table.name(field.name)});
+            }
+            if(not emitEncodeStructure(field.firstChild, field.childCount, path, depth)){
+                return false;
+            }
+        } else {
+            path.push_back(PathPart{false, table.name(field.name)});
+            if(not emitEncodeElement(field, path, depth)){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Codegen::emitEncodeElement(const FieldDescriptor& field, const std::vector<PathPart>& parts, int depth){
+    if(not field.array){
+        return emitEncodeField(field, parts, depth);
+    }
+    std::string id = std::to_string(counter++);
+    std::string n = "n" + id;
+    if(field.repetitions == -1){
+        // Read until the input runs out: the interpreter ends with an error
+        line(depth) << "return false;\n";
+        return false;
+    }
+    if(field.repetitions == 0){
+        const std::string& reference = table.name(field.repetitionsReference);
+        std::string c = "c" + id;
+        if(reference.empty() || reference[0] != '/'){
+            line(depth) << "const nlohmann::ordered_json* " << c << " = nullptr;\n";
+        } else {
+            std::vector<PathPart> referenceParts;
+            size_t start = 1;
+            while(start <= reference.size()){
+                size_t end = reference.find('/', start);
+                if(end == std::string::npos){ end = reference.size(); }
+                std::string token = reference.substr(start, end - start);
+                for(size_t at = token.find("~1"); at != std::string::npos; at = token.find("~1", at + 1)){ token.replace(at, 2, "/"); }
+                for(size_t at = token.find("~0"); at != std::string::npos; at = token.find("~0", at + 1)){ token.replace(at, 2, "~"); }
+                referenceParts.push_back(PathPart{false, token});
+                start = end + 1;
+            }
+            line(depth) << "const nlohmann::ordered_json* " << c << " = " << lookup(referenceParts) << ";\n";
+        }
+        line(depth) << "if(" << c << " == nullptr || not (" << c << "->is_number() || " << c << "->is_boolean())){ return false; }\n";
+        line(depth) << "int " << n << " = " << c << "->get<unsigned int>();\n";
+        line(depth) << "if(" << n << " == -1){ return false; }\n";
+    } else {
+        line(depth) << "int " << n << " = " << field.repetitions << ";\n";
+    }
+    std::string i = "i" + id;
+    line(depth) << "for(int " << i << " = 0; " << i << " < " << n << "; " << i << "++){\n";
+    std::vector<PathPart> item = parts;
+    item.push_back(PathPart{true, i});
+    emitEncodeField(field, item, depth + 1);
+    line(depth) << "}\n";
+    return true;
+}
+
+bool Codegen::emitEncodeField(const FieldDescriptor& field, const std::vector<PathPart>& parts, int depth){
+    std::string id = std::to_string(counter++);
+    std::string v = "v" + id;
+    std::string e = "e" + id;
+    std::string length = std::to_string(field.bitLength);
+    std::string key = "0";
+    auto check = [&](const std::string& test){
+        line(depth) << "const nlohmann::ordered_json* " << v << " = " << lookup(parts) << ";\n";
+        line(depth) << "if(" << v << " == nullptr || not " << v << "->" << test << "()){ return false; }\n";
+    };
+    switch(field.type){
+        case MessageElement::MessageElementType::MET_INTEGER:
+            check("is_number_integer");
+            line(depth) << "int64_t " << e << " = " << v << "->get<int64_t>();\n";
+            line(depth) << "out.writeBits(static_cast<uint64_t>(" << e << "), " << length << ");\n";
+            key = "static_cast<int>(" + e + ")";
+            break;
+        case MessageElement::MessageElementType::MET_UNSIGNED_INTEGER:
+            check("is_number_unsigned");
+            line(depth) << "uint64_t " << e << " = " << v << "->get<uint64_t>();\n";
+            line(depth) << "out.writeBits(" << e << ", " << length << ");\n";
+            key = "static_cast<int>(" + e + ")";
+            break;
+        case MessageElement::MessageElementType::MET_DECIMAL:
+            check("is_number_float");
+            if(field.bitLength == 32){
+                line(depth) << "float " << e << " = static_cast<float>(" << v << "->get<double>());\n";
+                line(depth) << "uint32_t raw" << id << ";\n";
+            } else {
+                line(depth) << "double " << e << " = " << v << "->get<double>();\n";
+                line(depth) << "uint64_t raw" << id << ";\n";
+            }
+            line(depth) << "std::memcpy(&raw" << id << ", &" << e << ", sizeof(raw" << id << "));\n";
+            line(depth) << "out.writeBits(raw" << id << ", " << length << ");\n";
+            break;
+        case MessageElement::MessageElementType::MET_STRING:
+            check("is_string");
+            line(depth) << "const std::string& " << e << " = " << v << "->get_ref<const std::string&>();\n";
+            line(depth) << "if(" << e << ".size() * 8 == " << length << "){\n";
+            line(depth + 1) << "out.writeBytes(reinterpret_cast<const unsigned char*>(" << e << ".data()), " << e << ".size());\n";
+            line(depth) << "} else if(" << length << " < " << e << ".size() * 8){\n";
+            line(depth + 1) << "out.writeView(BitView(reinterpret_cast<const unsigned char*>(" << e << ".data()), 0, " << length << ", " << e << ".size()));\n";
+            line(depth) << "} else {\n";
+            line(depth + 1) << "out.writeBytes(reinterpret_cast<const unsigned char*>(" << e << ".data()), " << e << ".size());\n";
+            line(depth + 1) << "out.writeZeros(" << length << " - " << e << ".size() * 8);\n";
+            line(depth) << "}\n";
+            break;
+        case MessageElement::MessageElementType::MET_BOOLEAN:
+            check("is_boolean");
+            line(depth) << "out.writeBits(" << v << "->get<bool>() ? 1 : 0, " << length << ");\n";
+            break;
+        default:
+            line(depth) << "return false;\n";
+            return false;
+    }
+    if(field.routeCount == 0){
+        return true;
+    }
+    line(depth) << "switch(" << key << "){\n";
+    for(uint32_t r = field.firstRoute; r < field.firstRoute + field.routeCount; r++){
+        const FieldDescriptor& target = table.fields[table.routes[r].field];
+        std::vector<PathPart> path(parts.begin(), parts.end() - 1);
+        if(not target.flatten){
+            path.push_back(PathPart{false, table.name(target.name)});
+        }
+        line(depth) << "case " << table.routes[r].key << ": {\n";
+        bool next = target.type == MessageElement::MessageElementType::MET_STRUCTURE ?
+                    emitEncodeStructure(target.firstChild, target.childCount, path, depth + 1) :
+                    emitEncodeElement(target, path, depth + 1);
+        if(next){
+            line(depth + 1) << "break;\n";
+        }
+        line(depth) << "}\n";
+    }
+    line(depth) << "default:\n";
+    line(depth + 1) << "return false;\n";
+    line(depth) << "}\n";
+    return true;
+}
+
+std::string Codegen::lookup(const std::vector<PathPart>& parts) const {
+    std::string expression = "&input";
+    for(const auto& part : parts){
+        if(part.index){
+            expression = "GeneratedCodec::item(" + expression + ", " + part.token + ")";
+        } else {
+            expression = "GeneratedCodec::member(" + expression + ", " + quote(part.token) + ")";
+        }
+    }
+    return expression;
+}
+
+std::string Codegen::quote(const std::string& text){
+    std::ostringstream oss;
+    oss << '"';
+    for(unsigned char c : text){
+        if(c == '"' || c == '\\'){
+            oss << '\\' << c;
+        } else if(c < 0x20 || c >= 0x7f){
+            oss << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<int>(c) << std::dec;
+        } else {
+            oss << c;
+        }
+    }
+    oss << '"';
+    return oss.str();
+}
+
+std::string Codegen::identifier(const std::string& name){
+    std::string result;
+    for(char c : name){
+        result += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    if(result.empty() || std::isdigit(static_cast<unsigned char>(result[0]))){
+        result = "_" + result;
+    }
+    return result;
+}
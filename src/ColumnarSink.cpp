@@ -0,0 +1,600 @@
+#include "ColumnarSink.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+size_t ColumnarSink::Bitmap::count() const {
+    size_t set = 0;
+    for(uint8_t byte : bytes){
+        set += static_cast<size_t>(__builtin_popcount(byte));
+    }
+    return set;
+}
+
+static ColumnarSink::Type columnType(MessageElement::MessageElementType type){
+    switch(type){
+        case MessageElement::MessageElementType::MET_INTEGER: return ColumnarSink::Type::INT64;
+        case MessageElement::MessageElementType::MET_UNSIGNED_INTEGER: return ColumnarSink::Type::UINT64;
+        case MessageElement::MessageElementType::MET_DECIMAL: return ColumnarSink::Type::FLOAT64;
+        case MessageElement::MessageElementType::MET_BOOLEAN: return ColumnarSink::Type::BOOL;
+        default: return ColumnarSink::Type::UTF8;
+    }
+}
+
+// Type of a column written by fields of both types
+static ColumnarSink::Type widen(ColumnarSink::Type a, ColumnarSink::Type b){
+    using Type = ColumnarSink::Type;
+    auto integer = [](Type type){ return type == Type::INT64 || type == Type::UINT64; };
+    if(a == b){
+        return a;
+    } else if(integer(a) && integer(b)){
+        return Type::INT64;
+    } else if((integer(a) || a == Type::FLOAT64) && (integer(b) || b == Type::FLOAT64)){
+        return Type::FLOAT64;
+    }
+    return Type::UTF8;
+}
+
+void ColumnarSink::layout(const SchemaProgram& program){
+    if(source == &program){
+        return;
+    }
+    if(source != nullptr){
+        throw std::invalid_argument("Columnar sink already laid out for another schema");
+    }
+    source = &program;
+    columnOf.assign(program.paths.size(), noColumn);
+    for(const auto& instruction : program.code){
+        uint32_t path;
+        if(instruction.op == Instruction::OpCode::OP_FIELD && instruction.visible){
+            path = instruction.path;
+        } else if(instruction.op == Instruction::OpCode::OP_EXTEND && instruction.visible){
+            path = instruction.reference;
+        } else {
+            continue;
+        }
+        if(columnOf[path] == noColumn){
+            columnOf[path] = static_cast<uint32_t>(table.size());
+            Column column;
+            column.name = program.paths[path].pointer;
+            column.type = columnType(instruction.type);
+            for(const auto& segment : program.paths[path].segments){
+                if(segment.index){ column.arrays.push_back(segment.id); }
+            }
+            column.lists.resize(column.arrays.size());
+            column.last.resize(column.arrays.size());
+            table.push_back(std::move(column));
+        } else if(instruction.op == Instruction::OpCode::OP_FIELD){
+            Column& column = table[columnOf[path]];
+            column.type = widen(column.type, columnType(instruction.type));
+        }
+    }
+}
+
+void ColumnarSink::beginRow(){
+    touched.clear();
+    current = nullptr;
+}
+
+void ColumnarSink::field(uint32_t path, const std::vector<uint32_t>& indices){
+    Column& column = table[columnOf[path]];
+    current = &column;
+    overwrite = false;
+    size_t depth = column.lists.size();
+    size_t level = 0;
+    if(column.row != rowCount){
+        column.row = rowCount;
+        column.mark.resize(depth);
+        for(size_t i = 0; i < depth; i++){ column.mark[i] = column.lists[i].offsets.size(); }
+        column.markValues = column.size();
+        touched.push_back(columnOf[path]);
+        if(depth == 0){
+            return;
+        }
+        List& rows = column.lists[0];
+        rows.offsets.push_back(rows.offsets.back());
+        rows.validity.push(true);
+    } else {
+        // A value of the same element is replaced, otherwise a new element
+        // starts at the first array whose index has changed
+        while(level < depth && indices[column.arrays[level]] == column.last[level]){ level++; }
+        if(level == depth){
+            overwrite = true;
+            return;
+        }
+    }
+    for(; level < depth; level++){
+        List& list = column.lists[level];
+        uint32_t index = indices[column.arrays[level]];
+        column.last[level] = index;
+        // Items of the current slot not reached by the field are null
+        while(static_cast<uint32_t>(list.offsets.back() - list.offsets[list.offsets.size() - 2]) < index){
+            appendNull(column, level + 1);
+            list.offsets.back()++;
+        }
+        list.offsets.back()++;
+        if(level + 1 < depth){
+            List& items = column.lists[level + 1];
+            items.offsets.push_back(items.offsets.back());
+            items.validity.push(true);
+        }
+    }
+}
+
+// Null item at 'level': a slot of the list at that level, or a value below all of them
+void ColumnarSink::appendNull(Column& column, size_t level){
+    if(level < column.lists.size()){
+        List& list = column.lists[level];
+        list.offsets.push_back(list.offsets.back());
+        list.validity.push(false);
+        return;
+    }
+    column.validity.push(false);
+    switch(column.type){
+        case Type::BOOL: column.bits.push(false); break;
+        case Type::UTF8: column.offsets.push_back(column.offsets.back()); break;
+        default: column.values.push_back(0); break;
+    }
+}
+
+void ColumnarSink::putWord(uint64_t word){
+    if(overwrite){
+        current->values.back() = word;
+        current->validity.set(current->size() - 1, true);
+        return;
+    }
+    current->values.push_back(word);
+    current->validity.push(true);
+}
+
+void ColumnarSink::putBit(bool bit){
+    if(overwrite){
+        current->bits.set(current->size() - 1, bit);
+        current->validity.set(current->size() - 1, true);
+        return;
+    }
+    current->bits.push(bit);
+    current->validity.push(true);
+}
+
+void ColumnarSink::putText(const char* text, size_t length){
+    Column& column = *current;
+    if(overwrite){
+        column.text.resize(static_cast<size_t>(column.offsets[column.offsets.size() - 2]));
+        column.text.append(text, length);
+        column.offsets.back() = static_cast<int32_t>(column.text.size());
+        column.validity.set(column.size() - 1, true);
+        return;
+    }
+    column.text.append(text, length);
+    column.offsets.push_back(static_cast<int32_t>(column.text.size()));
+    column.validity.push(true);
+}
+
+void ColumnarSink::value(int64_t number){
+    switch(current->type){
+        case Type::FLOAT64: value(static_cast<double>(number)); break;
+        case Type::BOOL: putBit(number != 0); break;
+        case Type::UTF8:
+            {
+                std::string text = std::to_string(number);
+                putText(text.data(), text.size());
+                break;
+            }
+        default: putWord(static_cast<uint64_t>(number)); break;
+    }
+}
+
+void ColumnarSink::value(uint64_t number){
+    switch(current->type){
+        case Type::FLOAT64: value(static_cast<double>(number)); break;
+        case Type::BOOL: putBit(number != 0); break;
+        case Type::UTF8:
+            {
+                std::string text = std::to_string(number);
+                putText(text.data(), text.size());
+                break;
+            }
+        default: putWord(number); break;
+    }
+}
+
+void ColumnarSink::value(double number){
+    switch(current->type){
+        case Type::FLOAT64:
+            {
+                uint64_t word;
+                std::memcpy(&word, &number, sizeof(word));
+                putWord(word);
+                break;
+            }
+        case Type::UTF8:
+            {
+                char text[32];
+                int length = std::snprintf(text, sizeof(text), "%.17g", number);
+                putText(text, static_cast<size_t>(length));
+                break;
+            }
+        default: value(static_cast<int64_t>(number)); break;
+    }
+}
+
+void ColumnarSink::value(bool boolean){
+    switch(current->type){
+        case Type::BOOL: putBit(boolean); break;
+        case Type::UTF8: putText(boolean ? "true" : "false", boolean ? 4 : 5); break;
+        case Type::FLOAT64: value(boolean ? 1.0 : 0.0); break;
+        default: putWord(boolean ? 1 : 0); break;
+    }
+}
+
+void ColumnarSink::value(const char* text, size_t length){
+    if(current->type != Type::UTF8){
+        // Only met when a column mixes strings with other types, see widen()
+        throw std::invalid_argument("Text value for the column <" + current->name + ">");
+    }
+    JsonWriter::validateUtf8(text, length);
+    putText(text, length);
+}
+
+void ColumnarSink::endRow(){
+    for(auto& column : table){
+        if(column.row != rowCount){
+            appendNull(column, 0);
+        }
+    }
+    rowCount++;
+    touched.clear();
+    statuses.push_back(Status::OK);
+}
+
+// The values of the current row are dropped
+void ColumnarSink::discardRow(){
+    for(uint32_t index : touched){
+        Column& column = table[index];
+        for(size_t i = 0; i < column.lists.size(); i++){
+            column.lists[i].offsets.resize(column.mark[i]);
+            column.lists[i].validity.resize(column.mark[i] - 1);
+        }
+        column.validity.resize(column.markValues);
+        switch(column.type){
+            case Type::BOOL: column.bits.resize(column.markValues); break;
+            case Type::UTF8:
+                column.offsets.resize(column.markValues + 1);
+                column.text.resize(static_cast<size_t>(column.offsets.back()));
+                break;
+            default: column.values.resize(column.markValues); break;
+        }
+        column.row = SIZE_MAX;
+    }
+    touched.clear();
+}
+
+void ColumnarSink::appendError(const std::string& message){
+    errors.emplace_back(statuses.size(), message);
+    statuses.push_back(Status::ERROR);
+}
+
+void ColumnarSink::appendFiltered(){
+    statuses.push_back(Status::FILTERED);
+    filteredCount++;
+}
+
+const std::string& ColumnarSink::error(size_t index) const {
+    static const std::string none;
+    auto it = std::lower_bound(errors.begin(), errors.end(), index, [](const std::pair<size_t, std::string>& error, size_t message){
+        return error.first < message;
+    });
+    return it != errors.end() && it->first == index ? it->second : none;
+}
+
+// Offsets of another list appended to 'offsets'
+static void appendOffsets(std::vector<int32_t>& offsets, const std::vector<int32_t>& other){
+    int32_t base = offsets.back();
+    for(size_t i = 1; i < other.size(); i++){
+        offsets.push_back(base + other[i]);
+    }
+}
+
+void ColumnarSink::append(const ColumnarSink& other){
+    if(other.source == nullptr){
+        return;
+    }
+    if(source == nullptr){
+        layout(*other.source);
+    } else if(source != other.source){
+        throw std::invalid_argument("Columnar sinks of different schemas");
+    }
+    for(size_t c = 0; c < table.size(); c++){
+        Column& column = table[c];
+        const Column& part = other.table[c];
+        for(size_t i = 0; i < column.lists.size(); i++){
+            appendOffsets(column.lists[i].offsets, part.lists[i].offsets);
+            column.lists[i].validity.append(part.lists[i].validity);
+        }
+        column.validity.append(part.validity);
+        column.values.insert(column.values.end(), part.values.begin(), part.values.end());
+        column.bits.append(part.bits);
+        int32_t base = static_cast<int32_t>(column.text.size());
+        for(size_t i = 1; i < part.offsets.size(); i++){
+            column.offsets.push_back(base + part.offsets[i]);
+        }
+        column.text += part.text;
+    }
+    for(const auto& error : other.errors){
+        errors.emplace_back(statuses.size() + error.first, error.second);
+    }
+    statuses.insert(statuses.end(), other.statuses.begin(), other.statuses.end());
+    rowCount += other.rowCount;
+    filteredCount += other.filteredCount;
+}
+
+void ColumnarSink::clear(){
+    for(auto& column : table){
+        for(auto& list : column.lists){
+            list.offsets.resize(1);
+            list.validity.clear();
+        }
+        column.validity.clear();
+        column.values.clear();
+        column.bits.clear();
+        column.offsets.resize(1);
+        column.text.clear();
+        column.row = SIZE_MAX;
+    }
+    touched.clear();
+    current = nullptr;
+    rowCount = 0;
+    statuses.clear();
+    errors.clear();
+    filteredCount = 0;
+}
+
+// Minimal FlatBuffers builder for the Arrow IPC metadata. As in the reference
+// builder the buffer grows towards its front: an object is known by its
+// distance from the end of the buffer, and is written before the objects
+// that refer to it.
+class FlatBuilder {
+public:
+    using Offset = uint32_t;
+
+    template<typename T>
+    void scalar(T value) {
+        preAlign(sizeof(T), sizeof(T));
+        char raw[sizeof(T)];
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(T));
+        for(size_t i = 0; i < sizeof(T); i++){
+            raw[i] = static_cast<char>((bits >> (8 * i)) & 0xff);
+        }
+        bytes.insert(0, raw, sizeof(T));
+    }
+
+    // Reference to an object already written
+    void offset(Offset target) {
+        preAlign(4, 4);
+        scalar<uint32_t>(static_cast<uint32_t>(bytes.size() + 4 - target));
+    }
+
+    Offset string(const std::string& text) {
+        preAlign(text.size() + 1, 4);
+        bytes.insert(0, 1, '\0');
+        bytes.insert(0, text);
+        scalar<uint32_t>(static_cast<uint32_t>(text.size()));
+        return here();
+    }
+
+    Offset vector(const std::vector<Offset>& items) {
+        preAlign(items.size() * 4, 4);
+        for(size_t i = items.size(); i-- > 0;){
+            offset(items[i]);
+        }
+        scalar<uint32_t>(static_cast<uint32_t>(items.size()));
+        return here();
+    }
+
+    // Vector of structs of two longs (Buffer, FieldNode)
+    Offset vector(const std::vector<std::pair<int64_t, int64_t>>& items) {
+        preAlign(items.size() * 16, 4);
+        preAlign(items.size() * 16, 8);
+        for(size_t i = items.size(); i-- > 0;){
+            scalar<int64_t>(items[i].second);
+            scalar<int64_t>(items[i].first);
+        }
+        scalar<uint32_t>(static_cast<uint32_t>(items.size()));
+        return here();
+    }
+
+    void startTable() {
+        fields.clear();
+        tableStart = bytes.size();
+    }
+
+    template<typename T>
+    void field(uint16_t id, T value) {
+        scalar<T>(value);
+        fields.emplace_back(id, here());
+    }
+
+    void reference(uint16_t id, Offset target) {
+        offset(target);
+        fields.emplace_back(id, here());
+    }
+
+    Offset endTable() {
+        scalar<int32_t>(0);
+        Offset table = here();
+        uint16_t slots = 0;
+        for(const auto& entry : fields){ slots = std::max<uint16_t>(slots, static_cast<uint16_t>(entry.first + 1)); }
+        std::vector<uint16_t> vtable(slots, 0);
+        for(const auto& entry : fields){ vtable[entry.first] = static_cast<uint16_t>(table - entry.second); }
+        for(size_t i = slots; i-- > 0;){ scalar<uint16_t>(vtable[i]); }
+        scalar<uint16_t>(static_cast<uint16_t>(table - tableStart));
+        scalar<uint16_t>(static_cast<uint16_t>(4 + 2 * slots));
+        // The table starts with the distance back to its vtable
+        int32_t distance = static_cast<int32_t>(here() - table);
+        for(size_t i = 0; i < 4; i++){
+            bytes[bytes.size() - table + i] = static_cast<char>((static_cast<uint32_t>(distance) >> (8 * i)) & 0xff);
+        }
+        return table;
+    }
+
+    // The buffer with 'root' as its root table, its size a multiple of 8
+    const std::string& finish(Offset root) {
+        preAlign(4, 8);
+        offset(root);
+        return bytes;
+    }
+
+private:
+    std::string bytes;
+    std::vector<std::pair<uint16_t, Offset>> fields;
+    size_t tableStart = 0;
+
+    Offset here() const {return static_cast<Offset>(bytes.size());}
+    // Padding so that 'length' bytes written next end aligned on 'alignment'
+    void preAlign(size_t length, size_t alignment) {
+        bytes.insert(0, (alignment - (bytes.size() + length) % alignment) % alignment, '\0');
+    }
+};
+
+// Arrow IPC metadata (Schema.fbs, Message.fbs): union tags and field ids
+namespace arrow {
+    enum : uint8_t {SCHEMA = 1, RECORD_BATCH = 3};
+    enum : uint8_t {INT = 2, FLOATING_POINT = 3, UTF8 = 5, BOOL = 6, LIST = 12};
+    const int16_t metadataV5 = 4;
+    const int16_t doublePrecision = 2;
+    const size_t alignment = 64;
+}
+
+// Encapsulated message: continuation marker, length of the metadata,
+// the metadata and the body
+static void writeMessage(std::ostream& out, FlatBuilder& builder, uint8_t headerType, FlatBuilder::Offset header, int64_t bodyLength){
+    builder.startTable();
+    builder.field<int64_t>(3, bodyLength);
+    builder.reference(2, header);
+    builder.field<int16_t>(0, arrow::metadataV5);
+    builder.field<uint8_t>(1, headerType);
+    const std::string& metadata = builder.finish(builder.endTable());
+    uint32_t prefix[2] = {0xffffffffu, static_cast<uint32_t>(metadata.size())};
+    for(uint32_t word : prefix){
+        for(int i = 0; i < 4; i++){ out.put(static_cast<char>((word >> (8 * i)) & 0xff)); }
+    }
+    out.write(metadata.data(), static_cast<std::streamsize>(metadata.size()));
+}
+
+static FlatBuilder::Offset arrowField(FlatBuilder& builder, const std::string& name, uint8_t typeTag, FlatBuilder::Offset type,
+                                      const std::vector<FlatBuilder::Offset>& children){
+    FlatBuilder::Offset nameOffset = builder.string(name);
+    FlatBuilder::Offset childrenOffset = builder.vector(children);
+    builder.startTable();
+    builder.reference(0, nameOffset);
+    builder.reference(3, type);
+    builder.reference(5, childrenOffset);
+    builder.field<uint8_t>(1, 1);
+    builder.field<uint8_t>(2, typeTag);
+    return builder.endTable();
+}
+
+void ColumnarSink::writeSchema(std::ostream& out, const std::string& type) const {
+    FlatBuilder builder;
+    std::vector<FlatBuilder::Offset> fields;
+    for(const auto& column : table){
+        uint8_t tag;
+        builder.startTable();
+        switch(column.type){
+            case Type::INT64:
+            case Type::UINT64:
+                builder.field<int32_t>(0, 64);
+                builder.field<uint8_t>(1, column.type == Type::INT64 ? 1 : 0);
+                tag = arrow::INT;
+                break;
+            case Type::FLOAT64:
+                builder.field<int16_t>(0, arrow::doublePrecision);
+                tag = arrow::FLOATING_POINT;
+                break;
+            case Type::BOOL:
+                tag = arrow::BOOL;
+                break;
+            default:
+                tag = arrow::UTF8;
+                break;
+        }
+        FlatBuilder::Offset field = arrowField(builder, column.lists.empty() ? column.name : "item", tag, builder.endTable(), {});
+        for(size_t i = column.lists.size(); i-- > 0;){
+            builder.startTable();
+            field = arrowField(builder, i == 0 ? column.name : "item", arrow::LIST, builder.endTable(), {field});
+        }
+        fields.push_back(field);
+    }
+    FlatBuilder::Offset fieldsOffset = builder.vector(fields);
+    FlatBuilder::Offset key = builder.string("openformat.type");
+    FlatBuilder::Offset value = builder.string(type);
+    builder.startTable();
+    builder.reference(0, key);
+    builder.reference(1, value);
+    FlatBuilder::Offset metadata = builder.vector(std::vector<FlatBuilder::Offset>{builder.endTable()});
+    builder.startTable();
+    builder.reference(1, fieldsOffset);
+    builder.reference(2, metadata);
+    builder.field<int16_t>(0, 0);   // little endian
+    writeMessage(out, builder, arrow::SCHEMA, builder.endTable(), 0);
+}
+
+void ColumnarSink::writeBatch(std::ostream& out) const {
+    std::vector<std::pair<int64_t, int64_t>> nodes;     // length and null count
+    std::vector<std::pair<int64_t, int64_t>> layout;    // offset and length in the body
+    std::vector<std::pair<const void*, size_t>> buffers;
+    int64_t bodyLength = 0;
+    auto buffer = [&](const void* data, size_t length){
+        layout.emplace_back(bodyLength, static_cast<int64_t>(length));
+        buffers.emplace_back(data, length);
+        bodyLength += static_cast<int64_t>((length + arrow::alignment - 1) / arrow::alignment * arrow::alignment);
+    };
+    auto node = [&](const Bitmap& validity){
+        nodes.emplace_back(static_cast<int64_t>(validity.size()), static_cast<int64_t>(validity.size() - validity.count()));
+        buffer(validity.data().data(), validity.data().size());
+    };
+    // Fields in depth first order: the lists enclosing a column, then its values
+    for(const auto& column : table){
+        for(const auto& list : column.lists){
+            node(list.validity);
+            buffer(list.offsets.data(), list.offsets.size() * sizeof(int32_t));
+        }
+        node(column.validity);
+        if(column.type == Type::BOOL){
+            buffer(column.bits.data().data(), column.bits.data().size());
+        } else if(column.type == Type::UTF8){
+            buffer(column.offsets.data(), column.offsets.size() * sizeof(int32_t));
+            buffer(column.text.data(), column.text.size());
+        } else {
+            buffer(column.values.data(), column.values.size() * sizeof(uint64_t));
+        }
+    }
+    FlatBuilder builder;
+    FlatBuilder::Offset nodesOffset = builder.vector(nodes);
+    FlatBuilder::Offset buffersOffset = builder.vector(layout);
+    builder.startTable();
+    builder.field<int64_t>(0, static_cast<int64_t>(rowCount));
+    builder.reference(1, nodesOffset);
+    builder.reference(2, buffersOffset);
+    writeMessage(out, builder, arrow::RECORD_BATCH, builder.endTable(), bodyLength);
+    static const char padding[arrow::alignment] = {};
+    for(const auto& part : buffers){
+        out.write(static_cast<const char*>(part.first), static_cast<std::streamsize>(part.second));
+        out.write(padding, static_cast<std::streamsize>((arrow::alignment - part.second % arrow::alignment) % arrow::alignment));
+    }
+}
+
+void ColumnarSink::writeEnd(std::ostream& out){
+    static const char marker[8] = {'\xff', '\xff', '\xff', '\xff', 0, 0, 0, 0};
+    out.write(marker, sizeof(marker));
+}
+
+void ColumnarSink::writeTo(std::ostream& out, const std::string& type) const {
+    writeSchema(out, type);
+    writeBatch(out);
+    writeEnd(out);
+}
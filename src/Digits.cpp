@@ -0,0 +1,292 @@
+#include "Digits.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DIGITS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr uint64_t powers[Digits::maxDigits + 1] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+constexpr uint64_t sixteenDigits = powers[16];
+
+// BCD digits right aligned in two words: 'low' holds the last 16 of them,
+// 'high' the ones before
+void splitBcd(const unsigned char* src, size_t count, uint64_t& high, uint64_t& low) {
+    unsigned char buffer[16] = {};
+    size_t bytes = (count + 1) >> 1;
+    std::memcpy(buffer + 16 - bytes, src, bytes);
+    high = 0;
+    low = 0;
+    for(int i = 0; i < 8; i++){
+        high = (high << 8) | buffer[i];
+        low = (low << 8) | buffer[i + 8];
+    }
+    if(count & 1){
+        // The low nibble of the last byte is not a digit
+        low = (low >> 4) | (high << 60);
+        high >>= 4;
+    }
+}
+
+// The reverse of splitBcd()
+void joinBcd(uint64_t high, uint64_t low, unsigned char* dst, size_t count) {
+    if(count & 1){
+        high = (high << 4) | (low >> 60);
+        low <<= 4;
+    }
+    unsigned char buffer[16];
+    for(int i = 0; i < 8; i++){
+        buffer[i] = static_cast<unsigned char>(high >> (56 - 8 * i));
+        buffer[i + 8] = static_cast<unsigned char>(low >> (56 - 8 * i));
+    }
+    size_t bytes = (count + 1) >> 1;
+    std::memcpy(dst, buffer + 16 - bytes, bytes);
+}
+
+// A nibble above 9 has bit 3 set together with bit 2 or bit 1
+bool validBcd(uint64_t nibbles) {
+    return ((nibbles >> 3) & ((nibbles >> 2) | (nibbles >> 1)) & 0x1111111111111111ULL) == 0;
+}
+
+// 16 BCD digits folded in three multiply-adds on the lanes of the word:
+// digit pairs, then groups of 4 and of 8
+uint64_t foldBcd(uint64_t x) {
+    x = ((x >> 4) & 0x0f0f0f0f0f0f0f0fULL) * 10 + (x & 0x0f0f0f0f0f0f0f0fULL);
+    x = ((x >> 8) & 0x00ff00ff00ff00ffULL) * 100 + (x & 0x00ff00ff00ff00ffULL);
+    x = ((x >> 16) & 0x0000ffff0000ffffULL) * 10000 + (x & 0x0000ffff0000ffffULL);
+    return (x >> 32) * 100000000ULL + (x & 0xffffffffULL);
+}
+
+// 'value' (below 10^16) as 16 BCD digits
+uint64_t toBcd(uint64_t value) {
+    uint64_t nibbles = 0;
+    for(int shift = 0; value; shift += 4, value /= 10){
+        nibbles |= (value % 10) << shift;
+    }
+    return nibbles;
+}
+
+// 8 ASCII digits read as one word, the first one in the high byte: each
+// byte is checked to be in '0'..'9' (adding 6 keeps the high nibble at 3),
+// then folded like foldBcd() with bytes instead of nibbles
+bool foldAscii(const char* src, uint64_t& value) {
+    uint64_t x;
+    std::memcpy(&x, src, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    if(((x & 0xf0f0f0f0f0f0f0f0ULL) | (((x + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)) != 0x3333333333333333ULL){
+        return false;
+    }
+    x -= 0x3030303030303030ULL;
+    x = ((x >> 8) & 0x00ff00ff00ff00ffULL) * 10 + (x & 0x00ff00ff00ff00ffULL);
+    x = ((x >> 16) & 0x0000ffff0000ffffULL) * 100 + (x & 0x0000ffff0000ffffULL);
+    value = (x >> 32) * 10000 + (x & 0xffffffffULL);
+    return true;
+}
+
+// Groups of 8 digits a word at a time, the first one led by zeros
+bool parseAsciiScalar(const char* src, size_t count, uint64_t& value) {
+    uint64_t result = 0;
+    size_t head = count % 8;
+    if(head){
+        char buffer[8];
+        std::memset(buffer, '0', sizeof(buffer));
+        std::memcpy(buffer + 8 - head, src, head);
+        if(not foldAscii(buffer, result)){ return false; }
+    }
+    for(size_t i = head; i < count; i += 8){
+        uint64_t group;
+        if(not foldAscii(src + i, group)){ return false; }
+        result = result * 100000000ULL + group;
+    }
+    value = result;
+    return true;
+}
+
+bool parseBcdScalar(const unsigned char* src, size_t count, uint64_t& value) {
+    uint64_t high, low;
+    splitBcd(src, count, high, low);
+    if(not validBcd(high) || not validBcd(low)){ return false; }
+    value = foldBcd(high) * sixteenDigits + foldBcd(low);
+    return true;
+}
+
+void formatAsciiScalar(uint64_t value, char* dst, size_t count) {
+    for(size_t i = count; i-- > 0; value /= 10){
+        dst[i] = static_cast<char>('0' + value % 10);
+    }
+}
+
+void formatBcdScalar(uint64_t value, unsigned char* dst, size_t count) {
+    joinBcd(toBcd(value / sixteenDigits), toBcd(value % sixteenDigits), dst, count);
+}
+
+#ifdef DIGITS_X86
+
+// Digits in the 16 bytes of a register, one per byte, most significant
+// first, folded into their value: pairs with pmaddubsw, groups of 4 with
+// pmaddwd, packed back to 16 bits (packusdw) for the groups of 8.
+__attribute__((target("sse4.1")))
+uint64_t fold16(__m128i digits) {
+    const __m128i pairs = _mm_maddubs_epi16(digits, _mm_set1_epi16(0x010a));
+    const __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010064));
+    const __m128i packed = _mm_packus_epi32(quads, quads);
+    const __m128i octets = _mm_madd_epi16(packed, _mm_set1_epi32(0x00012710));
+    uint64_t high = static_cast<uint32_t>(_mm_cvtsi128_si32(octets));
+    uint64_t low = static_cast<uint32_t>(_mm_extract_epi32(octets, 1));
+    return high * 100000000ULL + low;
+}
+
+// The 8 digits of 'value' (below 10^8) in the 16 bit lanes, most significant
+// first: after W. Mula, "SSE: conversion integers to decimal representation".
+// The two halves of 4 digits are divided by 1000, 100, 10 and 1 at once with
+// reciprocal multiplications, then each quotient less 10 times the previous one.
+__attribute__((target("sse4.1")))
+__m128i spread8(uint32_t value) {
+    const __m128i abcdefgh = _mm_cvtsi32_si128(static_cast<int>(value));
+    const __m128i abcd = _mm_srli_epi64(_mm_mul_epu32(abcdefgh, _mm_set1_epi32(static_cast<int>(0xd1b71759))), 45);
+    const __m128i efgh = _mm_sub_epi32(abcdefgh, _mm_mul_epu32(abcd, _mm_set1_epi32(10000)));
+    const __m128i halves = _mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+    const __m128i spread = _mm_unpacklo_epi32(_mm_unpacklo_epi16(halves, halves), _mm_unpacklo_epi16(halves, halves));
+    const __m128i quotients = _mm_mulhi_epu16(_mm_mulhi_epu16(spread, _mm_setr_epi16(8389, 5243, 13108, -32768, 8389, 5243, 13108, -32768)),
+                                              _mm_setr_epi16(1 << 7, 1 << 11, 1 << 13, -32768, 1 << 7, 1 << 11, 1 << 13, -32768));
+    return _mm_sub_epi16(quotients, _mm_slli_epi64(_mm_mullo_epi16(quotients, _mm_set1_epi16(10)), 16));
+}
+
+// 'value' (below 10^16) as 16 digits, one per byte
+__attribute__((target("sse4.1")))
+__m128i spread16(uint64_t value) {
+    return _mm_packus_epi16(spread8(static_cast<uint32_t>(value / 100000000ULL)),
+                            spread8(static_cast<uint32_t>(value % 100000000ULL)));
+}
+
+__attribute__((target("sse4.1")))
+bool parseAsciiSSE41(const char* src, size_t count, uint64_t& value) {
+    uint64_t high = 0;
+    size_t head = count > 16 ? count - 16 : 0;
+    if(head && not parseAsciiScalar(src, head, high)){ return false; }
+    // The last 16 digits, after as many zeros as needed
+    char buffer[16];
+    std::memset(buffer, '0', sizeof(buffer));
+    std::memcpy(buffer + 16 - (count - head), src + head, count - head);
+    const __m128i digits = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer)), _mm_set1_epi8('0'));
+    const __m128i nine = _mm_set1_epi8(9);
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(digits, nine), nine)) != 0xffff){ return false; }
+    value = high * sixteenDigits + fold16(digits);
+    return true;
+}
+
+__attribute__((target("sse4.1")))
+bool parseBcdSSE41(const unsigned char* src, size_t count, uint64_t& value) {
+    uint64_t high, low;
+    splitBcd(src, count, high, low);
+    if(not validBcd(high) || not validBcd(low)){ return false; }
+    // Bytes most significant first, then each one split in its two nibbles
+    uint64_t ordered = __builtin_bswap64(low);
+    const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&ordered));
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i digits = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(packed, 4), mask), _mm_and_si128(packed, mask));
+    value = foldBcd(high) * sixteenDigits + fold16(digits);
+    return true;
+}
+
+__attribute__((target("sse4.1")))
+void formatAsciiSSE41(uint64_t value, char* dst, size_t count) {
+    char buffer[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), _mm_add_epi8(spread16(value % sixteenDigits), _mm_set1_epi8('0')));
+    size_t tail = count < 16 ? count : 16;
+    formatAsciiScalar(value / sixteenDigits, dst, count - tail);
+    std::memcpy(dst + count - tail, buffer + 16 - tail, tail);
+}
+
+__attribute__((target("sse4.1")))
+void formatBcdSSE41(uint64_t value, unsigned char* dst, size_t count) {
+    // Digit pairs joined into bytes, high nibble first
+    const __m128i pairs = _mm_maddubs_epi16(spread16(value % sixteenDigits), _mm_set1_epi16(0x0110));
+    uint64_t ordered;
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(&ordered), _mm_packus_epi16(pairs, pairs));
+    joinBcd(toBcd(value / sixteenDigits), __builtin_bswap64(ordered), dst, count);
+}
+
+#endif
+
+struct Kernels {
+    bool (*parseAscii)(const char*, size_t, uint64_t&);
+    bool (*parseBcd)(const unsigned char*, size_t, uint64_t&);
+    void (*formatAscii)(uint64_t, char*, size_t);
+    void (*formatBcd)(uint64_t, unsigned char*, size_t);
+    const char* name;
+};
+
+const Kernels scalarKernels = {parseAsciiScalar, parseBcdScalar, formatAsciiScalar, formatBcdScalar, "scalar"};
+#ifdef DIGITS_X86
+const Kernels sse41Kernels = {parseAsciiSSE41, parseBcdSSE41, formatAsciiSSE41, formatBcdSSE41, "sse4.1"};
+#endif
+
+// Kernels named 'name' if this CPU runs them, null otherwise
+const Kernels* findKernels(const char* name) {
+#ifdef DIGITS_X86
+    __builtin_cpu_init();
+    if(std::strcmp(name, sse41Kernels.name) == 0 && __builtin_cpu_supports("sse4.1")){ return &sse41Kernels; }
+#endif
+    return std::strcmp(name, scalarKernels.name) == 0 ? &scalarKernels : nullptr;
+}
+
+Kernels& kernels() {
+    static Kernels selected = findKernels("sse4.1") != nullptr ? *findKernels("sse4.1") : scalarKernels;
+    return selected;
+}
+
+bool fits(uint64_t value, size_t count) {
+    return count != 0 && count <= Digits::maxDigits && value < powers[count];
+}
+
+}
+
+bool Digits::parseAscii(const char* src, size_t count, uint64_t& value) {
+    return count != 0 && count <= maxDigits && kernels().parseAscii(src, count, value);
+}
+
+bool Digits::parseBcd(const unsigned char* src, size_t count, uint64_t& value) {
+    return count != 0 && count <= maxDigits && kernels().parseBcd(src, count, value);
+}
+
+bool Digits::formatAscii(uint64_t value, char* dst, size_t count) {
+    if(not fits(value, count)){ return false; }
+    kernels().formatAscii(value, dst, count);
+    return true;
+}
+
+bool Digits::formatBcd(uint64_t value, unsigned char* dst, size_t count) {
+    if(not fits(value, count)){ return false; }
+    kernels().formatBcd(value, dst, count);
+    return true;
+}
+
+size_t Digits::length(uint64_t value) {
+    size_t count = 1;
+    while(count < maxDigits && value >= powers[count]){
+        count++;
+    }
+    return count;
+}
+
+const char* Digits::implementation() {
+    return kernels().name;
+}
+
+bool Digits::select(const char* name) {
+    const Kernels* found = findKernels(name);
+    if(found == nullptr){ return false; }
+    kernels() = *found;
+    return true;
+}
@@ -1,497 +1,1324 @@
 #include "Engine.h"
 
-const std::pair<std::string, unsigned int> Engine::convertToBinary(const std::string& json_str, const Schema* schema_){
-    jsonFlatten = json::parse(json_str).flatten();
-    schema = schema_;
+#include <algorithm>
+#include <charconv>
+#include <type_traits>
 
-    Logger::getInstance().log("Setting engine input: " + jsonFlatten.unflatten().dump(), Logger::Level::DEBUG);
-    Logger::getInstance().log("Setting schema: " + schema->catalogName, Logger::Level::DEBUG);
+const std::pair<std::string, unsigned int> Engine::convertToBinary(const std::string& json_str, const Schema* schema_, DataFormat format){
+    encode(json_str, schema_, format);
+    return std::make_pair(bitWriter.toBase64(), static_cast<unsigned int>(bitWriter.getLength()));
+}
 
-    bitStream = new BitStream();
+const std::pair<std::string, unsigned int> Engine::convertToBytes(const std::string& json_str, const Schema* schema_, DataFormat format){
+    encode(json_str, schema_, format);
+    std::string bytes(reinterpret_cast<const char*>(bitWriter.getData()), bitWriter.getLengthInBytes());
+    return std::make_pair(std::move(bytes), static_cast<unsigned int>(bitWriter.getLength()));
+}
 
-    analizeJsonStructure(schema->structure, "");
-    if(jsonFlatten.size()>0){
-        Logger::getInstance().log("Remaining unprocessed keys in the json: "+jsonFlatten.unflatten().dump(), Logger::Level::WARNING);
-    }
+const std::pair<std::string, unsigned int> Engine::convertToBinary(const json& input, const Schema* schema_){
+    reset();
+    encode(input, schema_);
+    return std::make_pair(bitWriter.toBase64(), static_cast<unsigned int>(bitWriter.getLength()));
+}
 
-    return std::make_pair(bitStream->toBase64(),bitStream->getLength());
+const std::pair<std::string, unsigned int> Engine::convertToBytes(const json& input, const Schema* schema_){
+    reset();
+    encode(input, schema_);
+    std::string bytes(reinterpret_cast<const char*>(bitWriter.getData()), bitWriter.getLengthInBytes());
+    return std::make_pair(std::move(bytes), static_cast<unsigned int>(bitWriter.getLength()));
 }
 
-void Engine::analizeJsonElement(const MessageElement& element, const std::string& parentPath) {
-    if( !(evaluateExistingConditions(element.getExistingConditions())) ){
-        return;
+// SAX handler of the document to encode: it keeps the position of the
+// parser in Engine::steps and hands every value to Engine::offer()
+class Engine::DocumentReader {
+public:
+    explicit DocumentReader(Engine& engine_) : engine(engine_) {}
+
+    bool null() {
+        return scalar(json::value_t::null, [](JsonIndex::Value&){});
+    }
+    bool boolean(bool value) {
+        return scalar(json::value_t::boolean, [value](JsonIndex::Value& v){ v.boolean = value; });
+    }
+    bool number_integer(json::number_integer_t value) {
+        return scalar(json::value_t::number_integer, [value](JsonIndex::Value& v){ v.integer = value; });
+    }
+    bool number_unsigned(json::number_unsigned_t value) {
+        return scalar(json::value_t::number_unsigned, [value](JsonIndex::Value& v){ v.unsignedInteger = value; });
+    }
+    bool number_float(json::number_float_t value, const json::string_t&) {
+        return scalar(json::value_t::number_float, [value](JsonIndex::Value& v){ v.decimal = value; });
+    }
+    bool string(json::string_t& value) {
+        return scalar(json::value_t::string, [](JsonIndex::Value&){}, value);
+    }
+    bool binary(json::binary_t&) {
+        engine.nextMember();
+        throw std::invalid_argument("Binary value <" + engine.stepsPointer(engine.depth) + "> in the input");
+    }
+    bool start_object(std::size_t) {
+        engine.enterContainer(false);
+        return true;
+    }
+    bool key(json::string_t& name) {
+        engine.steps[engine.depth - 1].name.assign(name);
+        return true;
+    }
+    bool end_object() {
+        engine.leaveContainer();
+        return true;
+    }
+    bool start_array(std::size_t) {
+        engine.enterContainer(true);
+        return true;
+    }
+    bool end_array() {
+        engine.leaveContainer();
+        return true;
+    }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) {
+        throw std::invalid_argument(e.what());
     }
 
-    if(element.isArray()){
-        int repetitions = element.getRepetitions(); 
-        if(repetitions==0) {
-            Logger::getInstance().log("Evaluating reference as array size <" + element.getRepetitionsReference() + ">", Logger::Level::DEBUG);
-            if (jsonFlatten.contains(element.getRepetitionsReference())) {
-                repetitions = jsonFlatten[element.getRepetitionsReference()].get<unsigned int>();
-            } else {
-                Logger::getInstance().log("Repetitions reference not found or not yet analyzed", Logger::Level::ERROR);
-                Logger::getInstance().log(jsonFlatten.dump(), Logger::Level::DEBUG);
-                throw std::invalid_argument("Repetitions reference <" + element.getRepetitionsReference() + "> not found or not yet analyzed");
+    // The same events from a document already parsed
+    void read(const json& node) {
+        if(node.is_object()){
+            start_object(node.size());
+            for(auto it = node.begin(); it != node.end(); ++it){
+                engine.steps[engine.depth - 1].name.assign(it.key());
+                read(it.value());
             }
+            end_object();
+            return;
         }
-        Logger::getInstance().log("Repetitions <" + std::to_string(repetitions) + ">", Logger::Level::DEBUG);
-        element.forceIsArray(false);  // force to evaluate the element N times
-        for(size_t i=0; i < repetitions || repetitions==-1; i++){
-            analizeJsonElement(element, parentPath + "/" + std::to_string(i));
-            if(jsonFlatten.size()==0) break;
+        if(node.is_array()){
+            start_array(node.size());
+            for(const auto& item : node){
+                read(item);
+            }
+            end_array();
+            return;
         }
-    } else {
-        int routingMapKey = 0;
-        try{
-            std::unique_ptr<BitStream> bt;
-            MessageElement::MessageElementType type_ = element.getType();
-            std::string name_ = parentPath;
-            /*if(element.getType() == MessageElement::MessageElementType::MET_EXTENDED){
-                BitStream* origBt = bitStreamMap[element.getExtendElement()];
-                BitStream* aux;
-                if(element.getBitLength()){
-                    aux = new BitStream(bitStream->consume(element.getBitLength()));  
-                } else {
-                    aux = new BitStream(bitStream->consumeUntill(element.getDelimiter()));
+        switch(node.type()){
+            case json::value_t::boolean: boolean(node.get<bool>()); break;
+            case json::value_t::number_integer: number_integer(node.get<int64_t>()); break;
+            case json::value_t::number_unsigned: number_unsigned(node.get<uint64_t>()); break;
+            case json::value_t::number_float: scalar(json::value_t::number_float, [&node](JsonIndex::Value& v){ v.decimal = node.get<double>(); }); break;
+            case json::value_t::string: scalar(json::value_t::string, [](JsonIndex::Value&){}, node.get_ref<const std::string&>()); break;
+            case json::value_t::binary: engine.nextMember(); throw std::invalid_argument("Binary value <" + engine.stepsPointer(engine.depth) + "> in the input");
+            default: null(); break;
+        }
+    }
+
+private:
+    Engine& engine;
+
+    template<typename Set>
+    bool scalar(json::value_t type, Set set, std::string_view text = std::string_view()) {
+        engine.nextMember();
+        JsonIndex::Value value{};
+        value.type = type;
+        set(value);
+        engine.offer(value, text);
+        return true;
+    }
+};
+
+// The program of the schema runs while the SAX parser reads the document:
+// each value is written as soon as the parser meets it, if it is the next
+// one of the schema. Only the generated encoders need a DOM.
+void Engine::encode(std::string_view input, const Schema* schema_, DataFormat format){
+    reset();
+    if(schema_->generated != nullptr){
+        switch(format){
+            case DataFormat::CBOR:
+                encode(json::from_cbor(input.begin(), input.end()), schema_);
+                break;
+            case DataFormat::MSGPACK:
+                encode(json::from_msgpack(input.begin(), input.end()), schema_);
+                break;
+            default:
+                encode(json::parse(input.begin(), input.end()), schema_);
+                break;
+        }
+        return;
+    }
+    if(format == DataFormat::JSON && Logger::getInstance().isEnabled(Logger::Level::DEBUG)){
+        Logger::getInstance().log("Setting engine input: " + std::string(input), Logger::Level::DEBUG);
+    }
+    schema = schema_;
+    beginEncoding();
+    DocumentReader reader(*this);
+    switch(format){
+        case DataFormat::CBOR:
+            json::sax_parse(input.begin(), input.end(), &reader, nlohmann::detail::input_format_t::cbor);
+            break;
+        case DataFormat::MSGPACK:
+            json::sax_parse(input.begin(), input.end(), &reader, nlohmann::detail::input_format_t::msgpack);
+            break;
+        default:
+            json::sax_parse(input.begin(), input.end(), &reader, nlohmann::detail::input_format_t::json);
+            break;
+    }
+    endEncoding();
+}
+
+void Engine::encode(const json& input, const Schema* schema_){
+    schema = schema_;
+    if(schema->generated != nullptr){
+        bitWriter.reserve(schema->bitLengthHint);
+        if(schema->generated->encode(input, bitWriter)){
+            return;
+        }
+        // Anything the generated code does not handle is left to the interpreter
+    }
+    if(Logger::getInstance().isEnabled(Logger::Level::DEBUG)){
+        Logger::getInstance().log("Setting engine input: " + input.dump(), Logger::Level::DEBUG);
+    }
+    beginEncoding();
+    DocumentReader reader(*this);
+    reader.read(input);
+    endEncoding();
+}
+
+void Engine::beginEncoding(){
+    if(Logger::getInstance().isEnabled(Logger::Level::DEBUG)){
+        Logger::getInstance().log("Setting schema: " + schema->catalogName, Logger::Level::DEBUG);
+    }
+    program = schema->program.get();
+    registers.resize(program->registerCount);
+    bitWriter.clear();
+    bitWriter.reserve(schema->bitLengthHint);
+    document.clear();
+    closedArrays.clear();
+    depth = 0;
+    encodePc = 0;
+    encodeRoute = 0;
+    waiting = Wait::NONE;
+    documentEnded = false;
+    encoding = true;
+    resumeEncoding();
+}
+
+void Engine::endEncoding(){
+    documentEnded = true;
+    if(encoding){
+        if(waiting == Wait::ITEM){
+            nextItem();
+        }
+        resumeEncoding();
+    }
+    if(document.unused()>0){
+        Logger::getInstance().log("Remaining unprocessed keys in the json: "+document.toString(true), Logger::Level::WARNING);
+    }
+    if(Logger::getInstance().isEnabled(Logger::Level::DEBUG)){
+        Logger::getInstance().log("BITSTREAM: " + bitWriter.toString(), Logger::Level::DEBUG);
+    }
+}
+
+// Run the program until it needs a value the parser has not met yet, or
+// up to its end
+void Engine::resumeEncoding(){
+    waiting = Wait::NONE;
+    while(true){
+        const Instruction& instruction = program->code[encodePc];
+        switch(instruction.op){
+            case Instruction::OpCode::OP_FIELD:
+                {
+                    // Values met out of order are the only ones looked up
+                    const JsonIndex::Value* value = document.unused() ? document.take(pathPointer(instruction.path)) : nullptr;
+                    if(value == nullptr && not documentEnded){
+                        waiting = Wait::FIELD;
+                        return;
+                    }
+                    encodeField(instruction, value, value != nullptr ? document.text(*value) : std::string_view());
+                    encodePc++;
+                    break;
                 }
-                BitStream combinedBitStream = BitStream::combine(*origBt, *aux);
-                bt = new BitStream(combinedBitStream.getData(), combinedBitStream.getLength(), "");
-                type_ = MessageElement::MessageElementType::MET_UNSIGNED_INTEGER;
-                name_ = element.getExtendElement();
-            } else {
-                if(element.getBitLength()){
-                    bt = new BitStream(bitStream->consume(element.getBitLength()));  
-                } else {
-                    bt = new BitStream(bitStream->consumeUntill(element.getDelimiter()));
+            case Instruction::OpCode::OP_EXTEND:
+                {
+                    const PathSegment& last = program->paths[instruction.path].segments.back();
+                    const std::string& name = last.index ? program->paths[instruction.path].pointer : program->names[last.id];
+                    Logger::getInstance().log("Usupported type <" + MessageElement::MessageElementTypeToString(instruction.type) + "> for field with name: " + name, Logger::Level::ERROR);
+                    throw std::invalid_argument("Usupported type <" + MessageElement::MessageElementTypeToString(instruction.type) + "> for field with name: " + name);
                 }
-            }*/
-            json jValue = jsonFlatten[parentPath];
-            switch(type_){
-                case MessageElement::MessageElementType::MET_INTEGER:
-                    {
-                        if(jValue.type() != json::value_t::number_integer &&
-                           jValue.type() != json::value_t::number_unsigned){
-                            throw std::invalid_argument("Invalid type for element <" + parentPath + ">");
-                        }
-                        int value = static_cast<int>(jValue.get<int64_t>());
-                        unsigned char bytes[sizeof(int)];
-                        unsigned int numberOfBytes = element.getBitLength()+7>>3;
-                        if(numberOfBytes==2){
-                            unsigned char plain[sizeof(int)];
-                            std::memcpy(plain, &value, sizeof(int));
-                            bytes[0] = plain[1];
-                            bytes[1] = plain[0];
-                        } else if(numberOfBytes==4) {
-                            unsigned char plain[sizeof(int)];
-                            std::memcpy(plain, &value, sizeof(int));
-                            bytes[0] = plain[3];
-                            bytes[1] = plain[2];
-                            bytes[2] = plain[1];
-                            bytes[3] = plain[0];
-                        } else {
-                            std::memcpy(bytes, &value, sizeof(int));
-                        }
-                        bt = std::make_unique<BitStream>(bytes, element.getBitLength(), "");
-                        routingMapKey = value;
-                        break;
-                    }
-                case MessageElement::MessageElementType::MET_UNSIGNED_INTEGER:
-                    {
-                        if(jValue.type() != json::value_t::number_unsigned){
-                            throw std::invalid_argument("Invalid type for element <" + parentPath + ">");
-                        }
-                        unsigned int value = jValue.get<unsigned int>();
-                        unsigned char bytes[sizeof(unsigned int)];
-                        unsigned int numberOfBytes = element.getBitLength()+7>>3;
-                        if(numberOfBytes==2){
-                            unsigned char plain[sizeof(unsigned int)];
-                            std::memcpy(bytes, &value, sizeof(unsigned int));
-//                            std::memcpy(plain, &value, sizeof(unsigned int));
-//                            bytes[0] = plain[1];
-//                            bytes[1] = plain[0];
-                        } else if(numberOfBytes==4) {
-                            unsigned char plain[sizeof(unsigned int)];
-                            std::memcpy(plain, &value, sizeof(unsigned int));
-                            bytes[0] = plain[3];
-                            bytes[1] = plain[2];
-                            bytes[2] = plain[1];
-                            bytes[3] = plain[0];
-                        } else {
-                            std::memcpy(bytes, &value, sizeof(unsigned int));
-                        }
-                        bt = std::make_unique<BitStream>(bytes, element.getBitLength(), "");
-                        routingMapKey = static_cast<int>(value);
-                        break;
+            case Instruction::OpCode::OP_SKIP:
+                encodePc = instruction.jump;
+                break;
+            case Instruction::OpCode::OP_ROUTE:
+                {
+                    uint32_t target = program->routingTables[instruction.table].find(encodeRoute);
+                    if(target == RoutingTable::npos){
+                        std::string err_message = "Provided the routing key <" + std::to_string(encodeRoute) + "> that has not been configured for element <" + program->paths[instruction.path].pointer + ">";
+                        Logger::getInstance().log(err_message, Logger::Level::ERROR);
+                        throw std::invalid_argument(err_message);
                     }
-                case MessageElement::MessageElementType::MET_DECIMAL:
-                    {
-                        if(jValue.type() != json::value_t::number_float){
-                            throw std::invalid_argument("Invalid type for element <" + parentPath + ">");
+                    encodePc = target;
+                    break;
+                }
+            case Instruction::OpCode::OP_LOOP:
+                {
+                    int repetitions = instruction.repetitions;
+                    if(repetitions==0) {
+                        const Register& reg = registers[instruction.reg];
+                        if(not reg.set){
+                            Logger::getInstance().log("Repetitions reference not found or not yet analyzed", Logger::Level::ERROR);
+                            throw std::invalid_argument("Repetitions reference <" + program->paths[instruction.reference].pointer + "> not found or not yet analyzed");
                         }
-                        if(element.getBitLength()==32){
-                            float value = static_cast<float>(jValue.get<double>());
-                            unsigned char bytes1[4];
-                            unsigned char bytes[4];
-                            std::memcpy(bytes1, &value, 4);
-                            std::reverse_copy(bytes1, bytes1 + 4, bytes);
-                            bt = std::make_unique<BitStream>(bytes, element.getBitLength(), "");
-                        } else if(element.getBitLength()==64){
-                            double value = static_cast<double>(jValue.get<double>());
-                            unsigned char bytes1[8];
-                            unsigned char bytes[8];
-                            std::memcpy(bytes1, &value, 8);
-                            std::reverse_copy(bytes1, bytes1 + 8, bytes);
-                            bt = std::make_unique<BitStream>(bytes, element.getBitLength(), "");
-                        } 
-                        break;
+                        repetitions = static_cast<int>(reg.value);
                     }
-                case MessageElement::MessageElementType::MET_STRING:
-                    {
-                        if(jValue.type() != json::value_t::string){
-                            throw std::invalid_argument("Invalid type for element <" + parentPath + ">");
-                        }
-                        std::string value = jValue.get<std::string>();
-                        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(value.data());
-                        bt = std::make_unique<BitStream>(bytes, element.getBitLength(), "");
+                    if(repetitions==0){
+                        encodePc = instruction.jump;
                         break;
                     }
-                case MessageElement::MessageElementType::MET_BOOLEAN:
-                    {
-                        if(jValue.type() != json::value_t::boolean){
-                            throw std::invalid_argument("Invalid type for element <" + parentPath + ">");
+                    loops.push_back(repetitions);
+                    indices.push_back(0);
+                    if(repetitions==-1){
+                        itemLoop = encodePc;
+                        if(not nextItem()){
+                            return;
                         }
-                        unsigned char bytes = 0b00000000;
-                        if(jValue.get<bool>()){
-                            bytes = 0b00000001;
-                        }
-                        bt = std::make_unique<BitStream>(&bytes, element.getBitLength(), "");
                         break;
                     }
-                default:
-                    Logger::getInstance().log("Usupported type <" + MessageElement::MessageElementTypeToString(type_) + "> for field with name: " + element.getName(), Logger::Level::ERROR);
-                    throw std::invalid_argument("Usupported type <" + MessageElement::MessageElementTypeToString(type_) + "> for field with name: " + element.getName());
-                    break; 
-            }
-            if(element.isDelimited()){
-                //Append the delimiter (only 1 char is supported)
-                unsigned char delimiter_char = static_cast<unsigned char>(element.getDelimiter());
-                BitStream* delimiter = new BitStream(&delimiter_char,8,"");
-                bt->append(delimiter);
-            }
-            bitStream->append(bt.get());
-            bitStreamMap.emplace(name_,std::move(bt));
-            Logger::getInstance().log("BITSTREAM: " + bitStream->toString(), Logger::Level::DEBUG);
-                    
-        } catch (const std::exception& e) {
-            throw;
-        }
-        if(element.getRouting().size()){
-            // There is a routing map that must be analyzed
-            if(element.getRouting().count(routingMapKey)){
-                const MessageElement elementOfTheMap = element.getRouting().at(routingMapKey);
-                //std::string newParentPath = parentPath.substr(0, parentPath.rfind('/')) + "/" + elementOfTheMap.getName();    
-                std::string newParentPath = parentPath.substr(0, parentPath.rfind('/'));    
-                if(not elementOfTheMap.isFlattenStructure()){
-                    newParentPath += "/" + elementOfTheMap.getName();
-                } 
-                if(elementOfTheMap.getType() == MessageElement::MessageElementType::MET_STRUCTURE){
-                    if(elementOfTheMap.isArray()){
-                        int repetitions = elementOfTheMap.getRepetitions(); 
-                        if(repetitions==0) {
-                            Logger::getInstance().log("Evaluating reference as array size <" + elementOfTheMap.getRepetitionsReference() + ">", Logger::Level::DEBUG);
-                            if (jsonFlatten.contains(elementOfTheMap.getRepetitionsReference())) {
-                                repetitions = jsonFlatten[elementOfTheMap.getRepetitionsReference()].get<unsigned int>();
-                            } else {
-                                Logger::getInstance().log("Repetitions reference not found or not yet analyzed", Logger::Level::ERROR);
-                                Logger::getInstance().log(jsonFlatten.dump(), Logger::Level::DEBUG);
-                                throw std::invalid_argument("Repetitions reference <" + elementOfTheMap.getRepetitionsReference() + "> not found or not yet analyzed");
-                            }
-                        }
-                        Logger::getInstance().log("Repetitions <" + std::to_string(repetitions) + ">", Logger::Level::DEBUG);
-                        for(size_t i=0; i < repetitions || repetitions==-1; i++){
-                            analizeJsonStructure(elementOfTheMap.getStructure(), newParentPath + "/" + std::to_string(i));
-                            if(not bitStream->remainingBits()) break;
+                    encodePc++;
+                    break;
+                }
+            case Instruction::OpCode::OP_NEXT:
+                {
+                    uint32_t index = ++indices.back();
+                    int repetitions = loops.back();
+                    if(repetitions==-1){
+                        itemLoop = instruction.jump;
+                        if(not nextItem()){
+                            return;
                         }
+                    } else if(index < static_cast<uint32_t>(repetitions)){
+                        encodePc = instruction.jump + 1;
                     } else {
-                        analizeJsonStructure(elementOfTheMap.getStructure(), newParentPath);            
+                        loops.pop_back();
+                        indices.pop_back();
+                        encodePc++;
                     }
-                } else {
-                    analizeJsonElement(elementOfTheMap, newParentPath);            
+                    break;
                 }
-            } else {
-                // Routing key not found in the map
-                std::string err_message = "Provided the routing key <" + std::to_string(routingMapKey) + "> that has not been configured for element <" + element.getName() + ">";
-                Logger::getInstance().log(err_message, Logger::Level::ERROR);
-                throw std::invalid_argument(err_message);            
+            case Instruction::OpCode::OP_CONDITION:
+                encodePc = evaluateConditions(program->conditions[instruction.table]) ? encodePc + 1 : instruction.jump;
+                break;
+            case Instruction::OpCode::OP_BLOCK:
+                // The fields that follow are written one by one
+                encodePc++;
+                break;
+            case Instruction::OpCode::OP_JUMP:
+                encodePc = instruction.jump;
+                break;
+            case Instruction::OpCode::OP_END:
+                encoding = false;
+                return;
+        }
+    }
+}
+
+// An array of unknown length goes on while there is a value below the
+// pointer of its next item: false when that is not known until the parser
+// goes further
+bool Engine::nextItem(){
+    const Instruction& loop = program->code[itemLoop];
+    if(document.unused() && document.contains(pathPointer(loop.path))){
+        enterItem(true);
+        return true;
+    }
+    if(documentEnded || (not closedArrays.empty() && closed(loop.path))){
+        enterItem(false);
+        return true;
+    }
+    waiting = Wait::ITEM;
+    return false;
+}
+
+void Engine::enterItem(bool found){
+    if(found){
+        encodePc = itemLoop + 1;
+        return;
+    }
+    loops.pop_back();
+    indices.pop_back();
+    encodePc = program->code[itemLoop].jump;
+}
+
+// Whether the array holding the items at 'path' has been read whole
+bool Engine::closed(uint32_t path) const {
+    std::string pointer = pathPointer(path, program->paths[path].segments.size() - 1);
+    return std::find(closedArrays.begin(), closedArrays.end(), pointer) != closedArrays.end();
+}
+
+// A value met by the parser: written if the program waits for it, kept in
+// the index otherwise
+void Engine::offer(const JsonIndex::Value& value, std::string_view text){
+    while(waiting != Wait::NONE){
+        const Instruction& instruction = program->code[waiting == Wait::FIELD ? encodePc : itemLoop];
+        const std::vector<PathSegment>& segments = program->paths[instruction.path].segments;
+        if(waiting == Wait::FIELD){
+            if(segments.size() != depth || not atPath(segments, depth)){
+                break;
             }
+            encodeField(instruction, &value, text);
+            encodePc++;
+            resumeEncoding();
+            return;
         }
+        if(segments.size() > depth || not atPath(segments, segments.size())){
+            break;
+        }
+        enterItem(true);
+        resumeEncoding();
+    }
+    document.add(stepsPointer(depth), value, text);
+    if(depth){
+        steps[depth - 1].stashed = true;
     }
 }
 
-void Engine::analizeJsonStructure(const std::vector<MessageElement>& structure, const std::string& parentPath){
-    Logger::getInstance().log("Evaluating a structure of "+
-                              std::to_string(structure.size()) + " elements", Logger::Level::DEBUG);
-    for (auto it = structure.begin(); it != structure.end(); ++it) {
-        Logger::getInstance().log("Evaluating element <" + it->getName() +
-                                  "> as a <" + MessageElement::MessageElementTypeToString(it->getType()) + ">" +
-                                  " of <" + std::to_string(it->getBitLength()) + "> bit(s) from bit <"+ std::to_string(bitStream->getOffset()) + ">", Logger::Level::DEBUG);
-        if(it->getType() == MessageElement::MessageElementType::MET_STRUCTURE){ 
-            if(it->isArray()){
-                int repetitions = it->getRepetitions(); 
-                if(repetitions==0) {
-                    Logger::getInstance().log("Evaluating reference as array repetitions <" + it->getRepetitionsReference() + ">", Logger::Level::DEBUG);
-                    if (jsonFlatten.contains(it->getRepetitionsReference())) {
-                        repetitions = jsonFlatten[it->getRepetitionsReference()].get<unsigned int>();
-                    } else {
-                        Logger::getInstance().log("Repetitions reference not found or not yet analyzed", Logger::Level::ERROR);
-                        Logger::getInstance().log(jsonFlatten.dump(), Logger::Level::DEBUG);
-                        throw std::invalid_argument("Repetitions reference <" + it->getRepetitionsReference() + "> not found or not yet analyzed");
-                    }
-                }
-                Logger::getInstance().log("Repetitions <" + std::to_string(repetitions) + ">", Logger::Level::DEBUG);
-                it->forceIsArray(false);  // force to evaluate the element N times
-                for(int i=0; i < repetitions || repetitions==-1; i++){
-                    analizeJsonStructure(it->getStructure(), parentPath + "/" + std::to_string(i));
-                    if(jsonFlatten.size()==0) break;
-                }
-            } else {
-                std::string newParentPath = parentPath;    
-                if(not it->isFlattenStructure()){
-                    newParentPath += "/" + it->getName();
-                } 
-                analizeJsonStructure(it->getStructure(), newParentPath);    
-            }        
+void Engine::nextMember(){
+    if(depth && steps[depth - 1].array){
+        Step& step = steps[depth - 1];
+        step.index = step.next++;
+    }
+}
+
+void Engine::enterContainer(bool array){
+    nextMember();
+    if(depth == steps.size()){
+        steps.emplace_back();
+    }
+    Step& step = steps[depth++];
+    step.array = array;
+    step.next = 0;
+    step.index = 0;
+    step.name.clear();
+    step.stashed = false;
+}
+
+void Engine::leaveContainer(){
+    // No value is left for the item a loop waits for once its array is over
+    while(waiting == Wait::ITEM){
+        const std::vector<PathSegment>& segments = program->paths[program->code[itemLoop].path].segments;
+        if(segments.size() != depth || not atPath(segments, depth - 1)){
+            break;
+        }
+        enterItem(false);
+        resumeEncoding();
+    }
+    const Step& step = steps[depth - 1];
+    if(step.stashed){
+        if(step.array){
+            closedArrays.push_back(stepsPointer(depth - 1));
+        }
+        if(depth > 1){
+            steps[depth - 2].stashed = true;
+        }
+    }
+    depth--;
+}
+
+// Whether the parser is at the first 'count' segments of a path: array
+// indices are also found as the keys of an object
+bool Engine::atPath(const std::vector<PathSegment>& segments, size_t count) const {
+    for(size_t i = 0; i < count; i++){
+        const Step& step = steps[i];
+        const PathSegment& segment = segments[i];
+        if(segment.index){
+            uint32_t index = indices[segment.id];
+            if(step.array){
+                if(step.index != index){ return false; }
+                continue;
+            }
+            uint32_t key;
+            const char* end = step.name.data() + step.name.size();
+            auto [at, error] = std::from_chars(step.name.data(), end, key);
+            if(error != std::errc() || at != end || key != index){ return false; }
+        } else if(step.array || step.name != program->names[segment.id]){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Pointers of the values kept in the index: where the parser is, and where
+// the program is for the first 'count' segments of a path
+std::string Engine::stepsPointer(size_t count) const {
+    std::string pointer;
+    for(size_t i = 0; i < count; i++){
+        if(steps[i].array){
+            pointer += '/';
+            pointer += std::to_string(steps[i].index);
         } else {
-            analizeJsonElement(*it, parentPath + "/" + it->getName());
+            JsonIndex::appendKey(pointer, steps[i].name);
         }
     }
+    return pointer;
 }
 
-const std::string Engine::convertToJson(const std::string& base64_str, const std::string& type_,  const Schema* schema_){
+std::string Engine::pathPointer(uint32_t path, size_t count) const {
+    const std::vector<PathSegment>& segments = program->paths[path].segments;
+    count = std::min(count, segments.size());
+    std::string pointer;
+    for(size_t i = 0; i < count; i++){
+        if(segments[i].index){
+            pointer += '/';
+            pointer += std::to_string(indices[segments[i].id]);
+        } else {
+            JsonIndex::appendKey(pointer, program->names[segments[i].id]);
+        }
+    }
+    return pointer;
+}
 
-    // Analize the bitstream based on <structure> described by the provided schema
-    bitStream = new BitStream(base64_str, type_);
-    schema = schema_;
-    analizeStructure(schema->structure, "");
+// Write the value of a field, null when missing, and keep it in its register
+void Engine::encodeField(const Instruction& instruction, const JsonIndex::Value* jValue, std::string_view text) {
+    Register scratch;
+    Register& reg = instruction.reg != Instruction::noRegister ? registers[instruction.reg] : scratch;
+    size_t bitLength = instruction.bitLength;
+    // A missing value is taken as null, which no type accepts
+    json::value_t valueType = jValue != nullptr ? jValue->type : json::value_t::null;
+    switch(instruction.type){
+        case MessageElement::MessageElementType::MET_INTEGER:
+            {
+                if(valueType != json::value_t::number_integer &&
+                   valueType != json::value_t::number_unsigned){
+                    throw std::invalid_argument("Invalid type for element <" + pathPointer(instruction.path) + ">");
+                }
+                int64_t value = jValue->asInteger();
+                if(instruction.encoding == MessageElement::NumericEncodingType::NE_BCD ||
+                   instruction.encoding == MessageElement::NumericEncodingType::NE_ASCII){
+                    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+                    writeDigits(instruction, magnitude, value < 0);
+                } else {
+                    bitWriter.writeBits(static_cast<uint64_t>(value), bitLength ? bitLength : minimumBytes(value) * 8);
+                }
+                reg.value = static_cast<uint64_t>(value);
+                encodeRoute = static_cast<int>(value);
+                break;
+            }
+        case MessageElement::MessageElementType::MET_UNSIGNED_INTEGER:
+            {
+                if(valueType != json::value_t::number_unsigned){
+                    throw std::invalid_argument("Invalid type for element <" + pathPointer(instruction.path) + ">");
+                }
+                uint64_t value = jValue->unsignedInteger;
+                if(instruction.encoding == MessageElement::NumericEncodingType::NE_BCD ||
+                   instruction.encoding == MessageElement::NumericEncodingType::NE_ASCII){
+                    writeDigits(instruction, value, false);
+                } else {
+                    bitWriter.writeBits(value, bitLength ? bitLength : minimumBytes(value) * 8);
+                }
+                reg.value = value;
+                encodeRoute = static_cast<int>(value);
+                break;
+            }
+        case MessageElement::MessageElementType::MET_DECIMAL:
+            {
+                if(valueType != json::value_t::number_float){
+                    throw std::invalid_argument("Invalid type for element <" + pathPointer(instruction.path) + ">");
+                }
+                if(bitLength==32){
+                    float value = static_cast<float>(jValue->decimal);
+                    uint32_t raw;
+                    std::memcpy(&raw, &value, sizeof(raw));
+                    bitWriter.writeBits(raw, 32);
+                } else if(bitLength==64){
+                    double value = jValue->decimal;
+                    uint64_t raw;
+                    std::memcpy(&raw, &value, sizeof(raw));
+                    bitWriter.writeBits(raw, 64);
+                } else {
+                    throw std::invalid_argument("Unsupported number of bits for decimal <" + pathPointer(instruction.path) + ">: " + std::to_string(bitLength));
+                }
+                reg.decimal = jValue->decimal;
+                break;
+            }
+        case MessageElement::MessageElementType::MET_STRING:
+            {
+                if(valueType != json::value_t::string){
+                    throw std::invalid_argument("Invalid type for element <" + pathPointer(instruction.path) + ">");
+                }
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+                size_t valueBits = text.size() * 8;
+                if(bitLength == 0 || bitLength == valueBits){
+                    bitWriter.writeBytes(bytes, text.size());
+                } else if(bitLength < valueBits){
+                    bitWriter.writeView(BitView(bytes, 0, bitLength, text.size()));
+                } else {
+                    // Shorter strings are padded with zeros
+                    bitWriter.writeBytes(bytes, text.size());
+                    bitWriter.writeZeros(bitLength - valueBits);
+                }
+                if(&reg != &scratch){ reg.text.assign(text.data(), text.size()); }
+                break;
+            }
+        case MessageElement::MessageElementType::MET_BOOLEAN:
+            {
+                if(valueType != json::value_t::boolean){
+                    throw std::invalid_argument("Invalid type for element <" + pathPointer(instruction.path) + ">");
+                }
+                bitWriter.writeBits(jValue->boolean ? 1 : 0, bitLength);
+                reg.value = jValue->boolean ? 1 : 0;
+                break;
+            }
+        default:
+            Logger::getInstance().log("Usupported type <" + MessageElement::MessageElementTypeToString(instruction.type) + "> for field with name: " + program->paths[instruction.path].pointer, Logger::Level::ERROR);
+            throw std::invalid_argument("Usupported type <" + MessageElement::MessageElementTypeToString(instruction.type) + "> for field with name: " + program->paths[instruction.path].pointer);
+            break; 
+    }
+    reg.set = true;
+    reg.type = instruction.type;
+    if(instruction.delimited){
+        //Append the delimiter (only 1 char is supported)
+        bitWriter.writeBits(static_cast<unsigned char>(instruction.delimiter), 8);
+    }
+}
 
-    if(bitStream->getOffset() < bitStream->getLength()){
-        Logger::getInstance().log("Remaining unprocessed bits in the bit stream: "+
-                                  std::to_string(bitStream->getLength()-bitStream->getOffset()) + " bit(s) left", Logger::Level::WARNING);
+// Integers written as decimal digits take the width of the field, or as
+// many digits as they need when it is delimited. In ASCII a negative
+// integer is led by '-'.
+void Engine::writeDigits(const Instruction& instruction, uint64_t magnitude, bool negative){
+    bool ascii = instruction.encoding == MessageElement::NumericEncodingType::NE_ASCII;
+    if(negative && not ascii){
+        throw std::invalid_argument("Negative value for BCD element <" + pathPointer(instruction.path) + ">");
+    }
+    unsigned int unit = ascii ? 8 : 4;
+    size_t sign = negative ? 1 : 0;
+    size_t count = instruction.bitLength ? instruction.bitLength / unit : Digits::length(magnitude) + sign;
+    unsigned char digits[Digits::maxDigits + 1];
+    bool written = instruction.bitLength % unit == 0 && count > sign && count - sign <= Digits::maxDigits;
+    if(written && ascii){
+        digits[0] = '-';
+        written = Digits::formatAscii(magnitude, reinterpret_cast<char*>(digits) + sign, count - sign);
+    } else if(written){
+        written = Digits::formatBcd(magnitude, digits, count);
+    }
+    if(not written){
+        throw std::invalid_argument("Value does not fit in the digits of element <" + pathPointer(instruction.path) + ">");
     }
+    if(ascii){
+        bitWriter.writeBytes(digits, count);
+    } else {
+        bitWriter.writeView(BitView(digits, 0, count * 4, (count + 1) / 2));
+    }
+}
 
-    std::string returnJson = jsonFlatten.unflatten().dump();
-    return returnJson;
+const std::string Engine::convertToJson(const std::string& base64_str, const std::string&, const Schema* schema_, const DecodeOptions& options){
+    reset();
+    unsigned char* data = arena.allocate<unsigned char>(Base64::decodedLength(base64_str.size()));
+    size_t lengthInBytes = Base64::decode(base64_str, data);
+    if(lengthInBytes==0){
+        Logger::getInstance().log("Passed base64 string generated no output", Logger::Level::WARNING);
+    }
+    bitStream.borrow(data, lengthInBytes * 8, lengthInBytes);
+    decode(schema_, options);
+    return rejected ? std::string() : decoded();
 }
 
-void Engine::analizeElement(const MessageElement& element, const std::string& parentPath) {
-    if( !(evaluateExistingConditions(element.getExistingConditions())) ){
-        return;
+const std::string Engine::convertToJson(const unsigned char* data, size_t bitLength, const std::string&, const Schema* schema_, const DecodeOptions& options){
+    reset();
+    if(bitLength==0){
+        throw std::invalid_argument("Trying to create a zero length bit stream");
     }
+    // The raw payload is borrowed, not copied: it must outlive the conversion
+    bitStream.borrow(data, bitLength, (bitLength + 7) >> 3);
+    decode(schema_, options);
+    return rejected ? std::string() : decoded();
+}
 
-    if(element.isArray()){
-        int repetitions = element.getRepetitions(); 
-        if(repetitions==0) {
-            Logger::getInstance().log("Evaluating reference as array size <" + element.getRepetitionsReference() + ">", Logger::Level::DEBUG);
-            if (jsonFlatten.contains(element.getRepetitionsReference())) {
-                repetitions = jsonFlatten[element.getRepetitionsReference()].get<unsigned int>();
-            } else {
-                Logger::getInstance().log("Repetitions reference not found or not yet analyzed", Logger::Level::ERROR);
-                Logger::getInstance().log(jsonFlatten.dump(), Logger::Level::DEBUG);
-                throw std::invalid_argument("Repetitions reference <" + element.getRepetitionsReference() + "> not found or not yet analyzed");
+// Messages sharing a schema decoded one after the other: a message that
+// fails gets its error in 'sink' and the next one is decoded anyway
+void Engine::convertToJsonBatch(Span<const BitView> messages, const Schema* schema_, OutputSink& sink, const DecodeOptions& options){
+    if(schema_ == nullptr){
+        throw std::invalid_argument("Schema not provided for the batch");
+    }
+    sink.reserve(messages.size(), messages.size() * lastOutputSize);
+    for(const BitView& message : messages){
+        try{
+            load(message);
+            decode(schema_, options);
+            if(rejected){
+                sink.appendFiltered();
+                continue;
             }
+            const std::string& result = decoded();
+            sink.append(result.data(), result.size());
+            lastOutputSize = result.size();
+        } catch (const std::exception& e) {
+            sink.appendError(e.what());
         }
-        Logger::getInstance().log("Repetitions <" + std::to_string(repetitions) + ">", Logger::Level::DEBUG);
-        element.forceIsArray(false);  // force to evaluate the element N times
-        for(size_t i=0; i < repetitions || repetitions==-1; i++){
-            analizeElement(element, parentPath + "/" + std::to_string(i));
-            if(not bitStream->remainingBits()) break;
+    }
+}
+
+void Engine::convertToColumns(Span<const BitView> messages, const Schema* schema_, ColumnarSink& sink, const DecodeOptions& options){
+    if(schema_ == nullptr){
+        throw std::invalid_argument("Schema not provided for the batch");
+    }
+    sink.layout(options.projection != nullptr ? *options.projection : *schema_->program);
+    for(const BitView& message : messages){
+        sink.beginRow();
+        try{
+            load(message);
+            prepare(schema_, options);
+            execute(sink);
+            if(rejected){
+                sink.discardRow();
+                sink.appendFiltered();
+                continue;
+            }
+            sink.endRow();
+        } catch (const std::exception& e) {
+            sink.discardRow();
+            sink.appendError(e.what());
         }
+    }
+}
+
+// Start a message of a batch
+void Engine::load(const BitView& message){
+    reset();
+    if(message.getLength()==0){
+        throw std::invalid_argument("Trying to create a zero length bit stream");
+    }
+    if((message.getOffset() % 8) == 0){
+        bitStream.borrow(message.getData() + (message.getOffset() >> 3), message.getLength(), message.getLengthInBytes());
     } else {
-        int routingMapKey = 0;
+        // The decoders expect the message to start on a byte
+        unsigned char* data = arena.allocate<unsigned char>(message.getLengthInBytes());
+        message.copyAlignedTo(data);
+        bitStream.borrow(data, message.getLength(), message.getLengthInBytes());
+    }
+}
+
+void Engine::convertToBinaryBatch(Span<const std::string_view> messages, const Schema* schema_, OutputSink& sink, DataFormat format){
+    if(schema_ == nullptr){
+        throw std::invalid_argument("Schema not provided for the batch");
+    }
+    sink.reserve(messages.size(), messages.size() * ((schema_->bitLengthHint + 7) >> 3));
+    for(std::string_view message : messages){
         try{
-//            BitStream* bt;
-            std::unique_ptr<BitStream> bt;
-            MessageElement::MessageElementType type_ = element.getType();
-            std::string name_ = parentPath;
-            if(element.getType() == MessageElement::MessageElementType::MET_EXTENDED){
-                BitStream* origBt = bitStreamMap[element.getExtendElement()].get();
-                BitStream* aux;
-                if(element.getBitLength()){
-                    aux = new BitStream(bitStream->consume(element.getBitLength()));  
-                } else {
-                    aux = new BitStream(bitStream->consumeUntill(element.getDelimiter()));
+            encode(message, schema_, format);
+            sink.append(reinterpret_cast<const char*>(bitWriter.getData()), bitWriter.getLengthInBytes(),
+                        static_cast<unsigned int>(bitWriter.getLength()));
+        } catch (const std::exception& e) {
+            sink.appendError(e.what());
+        }
+    }
+}
+
+Engine& Engine::local(){
+    thread_local Engine engine;
+    return engine;
+}
+
+// Every chunk goes into its own sink, the sinks are then joined in order
+template<typename Message, typename Sink, typename Convert>
+static void convertInParallel(ThreadPool& pool, Span<const Message> messages, Sink& sink, size_t chunk, Convert convert){
+    chunk = std::max<size_t>(chunk, 1);
+    size_t chunks = (messages.size() + chunk - 1) / chunk;
+    if(chunks <= 1){
+        convert(Engine::local(), messages, sink);
+        return;
+    }
+    std::vector<Sink> partial(chunks);
+    pool.parallelFor(chunks, 1, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            size_t first = i * chunk;
+            convert(Engine::local(), messages.subspan(first, std::min(chunk, messages.size() - first)), partial[i]);
+        }
+    });
+    for(const auto& part : partial){
+        sink.append(part);
+    }
+}
+
+void Engine::convertToJsonBatch(ThreadPool& pool, Span<const BitView> messages, const Schema* schema_, OutputSink& sink,
+                                const DecodeOptions& options, size_t chunk){
+    if(schema_ == nullptr){
+        throw std::invalid_argument("Schema not provided for the batch");
+    }
+    convertInParallel(pool, messages, sink, chunk, [schema_, &options](Engine& engine, Span<const BitView> part, OutputSink& out){
+        engine.convertToJsonBatch(part, schema_, out, options);
+    });
+}
+
+void Engine::convertToBinaryBatch(ThreadPool& pool, Span<const std::string_view> messages, const Schema* schema_, OutputSink& sink,
+                                  DataFormat format, size_t chunk){
+    if(schema_ == nullptr){
+        throw std::invalid_argument("Schema not provided for the batch");
+    }
+    convertInParallel(pool, messages, sink, chunk, [schema_, format](Engine& engine, Span<const std::string_view> part, OutputSink& out){
+        engine.convertToBinaryBatch(part, schema_, out, format);
+    });
+}
+
+void Engine::convertToColumns(ThreadPool& pool, Span<const BitView> messages, const Schema* schema_, ColumnarSink& sink,
+                              const DecodeOptions& options, size_t chunk){
+    if(schema_ == nullptr){
+        throw std::invalid_argument("Schema not provided for the batch");
+    }
+    convertInParallel(pool, messages, sink, chunk, [schema_, &options](Engine& engine, Span<const BitView> part, ColumnarSink& out){
+        engine.convertToColumns(part, schema_, out, options);
+    });
+}
+
+void Engine::reset(){
+    for(auto& reg : registers){
+        reg.clear();
+    }
+    indices.clear();
+    loops.clear();
+    levels.clear();
+    rootOpen = false;
+    output.clear();
+    cborOutput.clear();
+    msgpackOutput.clear();
+    bitWriter.clear();
+    arena.rewind();
+}
+
+// Execute the program compiled from the <structure> of the provided
+// schema, or the projection of it to the fields requested
+void Engine::prepare(const Schema* schema_, const DecodeOptions& options){
+    schema = schema_;
+    program = options.projection != nullptr ? options.projection : schema->program.get();
+    filter = options.filter;
+    format = options.format;
+    rejected = false;
+    if(filter != nullptr){
+        filterSeen.assign(filter->size(), 0);
+    }
+}
+
+void Engine::decode(const Schema* schema_, const DecodeOptions& options){
+    prepare(schema_, options);
+    switch(format){
+        case DataFormat::CBOR:
+            execute(cborOutput);
+            break;
+        case DataFormat::MSGPACK:
+            execute(msgpackOutput);
+            break;
+        default:
+            if(schema->generated != nullptr && options.projection == nullptr && filter == nullptr){
+                if(schema->generated->decode(bitStream.getData(), bitStream.getLength(), bitStream.getLengthInBytes(), output)){
+                    return;
+                }
+                output.clear();
+            }
+            execute(output);
+            break;
+    }
+}
+
+// Output of the last message decoded
+const std::string& Engine::decoded() const {
+    switch(format){
+        case DataFormat::CBOR: return cborOutput.str();
+        case DataFormat::MSGPACK: return msgpackOutput.str();
+        default: return output.str();
+    }
+}
+
+// Object keys of the program as written by each writer
+static const std::vector<std::string>& keysOf(const SchemaProgram& program, const JsonWriter&){ return program.keys; }
+static const std::vector<std::string>& keysOf(const SchemaProgram& program, const CborWriter&){ return program.cborKeys; }
+static const std::vector<std::string>& keysOf(const SchemaProgram& program, const MsgPackWriter&){ return program.msgpackKeys; }
+
+template<typename Writer>
+void Engine::execute(Writer& out){
+    registers.resize(program->registerCount);
+
+    int routingMapKey = 0;
+    uint32_t pc = 0;
+    bool running = true;
+    while(running){
+        const Instruction& instruction = program->code[pc];
+        switch(instruction.op){
+            case Instruction::OpCode::OP_FIELD:
+            case Instruction::OpCode::OP_EXTEND:
+                routingMapKey = decodeField(instruction, out);
+                if(rejected){
+                    return;
                 }
-                BitStream combinedBitStream = BitStream::combine(*origBt, *aux);
-//                bt = new BitStream(combinedBitStream.getData(), combinedBitStream.getLength(), "");
-                bt = std::make_unique<BitStream>(combinedBitStream.getData(), combinedBitStream.getLength(), "");
-                type_ = MessageElement::MessageElementType::MET_UNSIGNED_INTEGER;
-                name_ = element.getExtendElement();
-            } else {
-                if(element.getBitLength()){
-//                    bt = new BitStream(bitStream->consume(element.getBitLength()));  
-                    bt = std::make_unique<BitStream>(bitStream->consume(element.getBitLength()));
+                pc++;
+                break;
+            case Instruction::OpCode::OP_SKIP:
+                if(instruction.bitLength){
+                    bitStream.consumeView(instruction.bitLength);
                 } else {
-//                    bt = new BitStream(bitStream->consumeUntill(element.getDelimiter()));
-                    bt = std::make_unique<BitStream>(bitStream->consumeUntill(element.getBitLength()));
+                    bitStream.consumeViewUntill(instruction.delimiter);
+                    bitStream.shift(8);
                 }
-            }
-            nlohmann::json jValue;
-            switch(type_){
-                case MessageElement::MessageElementType::MET_INTEGER:
-                    {
-                        int value;
-                        if(element.getNumericEncoding() == MessageElement::NumericEncodingType::NE_BCD){
-                            value = bt->to_int_bcd(element.getBitLength());
-                        } else {
-                            value = bt->to_int(element.getBitLength());
-                        }
-                        jValue = value;
-                        routingMapKey = value;    
-                        break;
+                pc = instruction.jump;
+                break;
+            case Instruction::OpCode::OP_ROUTE:
+                {
+                    uint32_t target = program->routingTables[instruction.table].find(routingMapKey);
+                    if(target == RoutingTable::npos){
+                        std::string err_message = "Provided the routing key <" + std::to_string(routingMapKey) + "> that has not been configured for element <" + program->paths[instruction.path].pointer + ">";
+                        Logger::getInstance().log(err_message, Logger::Level::ERROR);
+                        throw std::invalid_argument(err_message);
                     }
-                case MessageElement::MessageElementType::MET_UNSIGNED_INTEGER:
-                    {
-                        int value;
-                        if(element.getNumericEncoding() == MessageElement::NumericEncodingType::NE_BCD){
-                            value = bt->to_int_bcd(element.getBitLength());
-                        } else {
-                            value = bt->to_uint(element.getBitLength());
+                    pc = target;
+                    break;
+                }
+            case Instruction::OpCode::OP_LOOP:
+                {
+                    int repetitions = instruction.repetitions;
+                    if(repetitions==0) {
+                        const Register& reg = registers[instruction.reg];
+                        if(not reg.set){
+                            Logger::getInstance().log("Repetitions reference not found or not yet analyzed", Logger::Level::ERROR);
+                            throw std::invalid_argument("Repetitions reference <" + program->paths[instruction.reference].pointer + "> not found or not yet analyzed");
                         }
-                        jValue = value;
-                        routingMapKey = value;    
-                        break;
+                        repetitions = static_cast<int>(reg.value);
                     }
-                case MessageElement::MessageElementType::MET_DECIMAL:
-                    {
-                        double value = bt->to_double(element.getBitLength());
-                        jValue = value;
+                    if(repetitions==0){
+                        pc = instruction.jump;
                         break;
                     }
-                case MessageElement::MessageElementType::MET_STRING:
-                    {
-                        std::string value = bt->to_string();
-                        jValue = value;
-                        break;
+                    loops.push_back(repetitions);
+                    indices.push_back(0);
+                    pc++;
+                    break;
+                }
+            case Instruction::OpCode::OP_NEXT:
+                {
+                    uint32_t index = ++indices.back();
+                    int repetitions = loops.back();
+                    if((repetitions==-1 || index < static_cast<uint32_t>(repetitions)) && bitStream.remainingBits()){
+                        pc = instruction.jump + 1;
+                    } else {
+                        loops.pop_back();
+                        indices.pop_back();
+                        pc++;
                     }
-                case MessageElement::MessageElementType::MET_BOOLEAN:
-                    {
-                        bool value = bt->to_boolean();
-                        jValue = value;
+                    break;
+                }
+            case Instruction::OpCode::OP_CONDITION:
+                pc = evaluateConditions(program->conditions[instruction.table]) ? pc + 1 : instruction.jump;
+                break;
+            case Instruction::OpCode::OP_BLOCK:
+                {
+                    if(bitStream.getOffset() + instruction.bitLength > bitStream.getLength()){
+                        // The fields report where the message ends, one by one
+                        pc++;
                         break;
                     }
-                default:
-                    Logger::getInstance().log("Usupported type <" + MessageElement::MessageElementTypeToString(type_) + "> for field with name: " + element.getName(), Logger::Level::ERROR);
-                    throw std::invalid_argument("Usupported type <" + MessageElement::MessageElementTypeToString(type_) + "> for field with name: " + element.getName());
-                    break; 
-            }
-            bitStreamMap.emplace(name_,std::move(bt));
-//            bitStreamMap[name_] = std::move(bt);
-            if(element.isVisible()){ jsonFlatten[name_] = jValue; }
-
-        } catch (const std::exception& e) {
-            throw;
-        }
-        if(element.getRouting().size()){
-            // There is a routing map that must be analyzed
-            if(element.getRouting().count(routingMapKey)){
-                const MessageElement elementOfTheMap = element.getRouting().at(routingMapKey);
-                //std::string newParentPath = parentPath.substr(0, parentPath.rfind('/')) + "/" + elementOfTheMap.getName();    
-                std::string newParentPath = parentPath.substr(0, parentPath.rfind('/'));    
-                if(not elementOfTheMap.isFlattenStructure()){
-                    newParentPath += "/" + elementOfTheMap.getName();
-                } 
-                if(elementOfTheMap.getType() == MessageElement::MessageElementType::MET_STRUCTURE){
-                    if(elementOfTheMap.isArray()){
-                        int repetitions = elementOfTheMap.getRepetitions(); 
-                        if(repetitions==0) {
-                            Logger::getInstance().log("Evaluating reference as array size <" + elementOfTheMap.getRepetitionsReference() + ">", Logger::Level::DEBUG);
-                            if (jsonFlatten.contains(elementOfTheMap.getRepetitionsReference())) {
-                                repetitions = jsonFlatten[elementOfTheMap.getRepetitionsReference()].get<unsigned int>();
-                            } else {
-                                Logger::getInstance().log("Repetitions reference not found or not yet analyzed", Logger::Level::ERROR);
-                                Logger::getInstance().log(jsonFlatten.dump(), Logger::Level::DEBUG);
-                                throw std::invalid_argument("Repetitions reference <" + elementOfTheMap.getRepetitionsReference() + "> not found or not yet analyzed");
-                            }
-                        }
-                        Logger::getInstance().log("Repetitions <" + std::to_string(repetitions) + ">", Logger::Level::DEBUG);
-                        for(size_t i=0; i < repetitions || repetitions==-1; i++){
-                            analizeStructure(elementOfTheMap.getStructure(), newParentPath + "/" + std::to_string(i));
-                            if(not bitStream->remainingBits()) break;
+                    // All the fields are extracted first, each one at its
+                    // own offset, and only then written
+                    const FixedBlock& block = program->blocks[instruction.table];
+                    BitView view = bitStream.consumeView(instruction.bitLength);
+                    size_t count = block.offsets.size();
+                    fixedValues.resize(count);
+                    uint64_t* values = fixedValues.data();
+                    for(size_t i = 0; i < count; i++){
+                        values[i] = view.readU64(block.offsets[i], block.bitLengths[i]);
+                    }
+                    for(size_t i = 0; i < count; i++){
+                        decodeFixed(program->code[block.fields[i]], values[i], out);
+                        if(rejected){
+                            return;
                         }
-                    } else {
-                        analizeStructure(elementOfTheMap.getStructure(), newParentPath);            
                     }
+                    pc = instruction.jump;
+                    break;
+                }
+            case Instruction::OpCode::OP_JUMP:
+                pc = instruction.jump;
+                break;
+            case Instruction::OpCode::OP_END:
+                running = false;
+                break;
+        }
+    }
+
+    if(bitStream.getOffset() < bitStream.getLength() && Logger::getInstance().isEnabled(Logger::Level::WARNING)){
+        Logger::getInstance().log("Remaining unprocessed bits in the bit stream: "+
+                                  std::to_string(bitStream.getLength()-bitStream.getOffset()) + " bit(s) left", Logger::Level::WARNING);
+    }
+
+    if(filter != nullptr && not filterMessage()){
+        rejected = true;
+        return;
+    }
+
+    if constexpr(not std::is_same_v<Writer, ColumnarSink>){
+        closeLevels(0, out);
+        if(rootOpen){
+            rootArray ? out.endArray() : out.endObject();
+        } else {
+            out.beginObject();
+            out.endObject();
+        }
+    }
+}
+
+// Position the output on a new member at 'path': the containers that are
+// not shared with the previous member are closed and the missing ones opened
+template<typename Writer>
+void Engine::openMember(uint32_t path, Writer& out){
+    const std::vector<PathSegment>& segments = program->paths[path].segments;
+    size_t depth = segments.size() - 1;
+    if(not rootOpen){
+        rootArray = segments[0].index;
+        rootArray ? out.beginArray() : out.beginObject();
+        rootOpen = true;
+    }
+    size_t common = 0;
+    while(common < levels.size() && common < depth){
+        const Level& level = levels[common];
+        const PathSegment& segment = segments[common];
+        if(level.segment.index != segment.index || level.segment.id != segment.id ||
+           (segment.index && level.index != indices[segment.id])){
+            break;
+        }
+        common++;
+    }
+    closeLevels(common, out);
+    for(size_t i = common; i < depth; i++){
+        const PathSegment& segment = segments[i];
+        openKey(segment, i, out);
+        bool array = segments[i + 1].index;
+        array ? out.beginArray() : out.beginObject();
+        levels.push_back(Level{segment, segment.index ? indices[segment.id] : 0, array});
+    }
+    openKey(segments[depth], depth, out);
+}
+
+// Start the member 'segment' of the container at 'depth': array indices
+// become keys when the container is an object
+template<typename Writer>
+void Engine::openKey(const PathSegment& segment, size_t depth, Writer& out){
+    static const std::string noKey;
+    bool array = depth ? levels[depth - 1].array : rootArray;
+    if(not segment.index){
+        out.member(keysOf(*program, out)[segment.id]);
+    } else if(array){
+        out.member(noKey);
+    } else {
+        out.member(Writer::renderKey(std::to_string(indices[segment.id])));
+    }
+}
+
+template<typename Writer>
+void Engine::closeLevels(size_t depth, Writer& out){
+    while(levels.size() > depth){
+        levels.back().array ? out.endArray() : out.endObject();
+        levels.pop_back();
+    }
+}
+
+// Read a single field at the current position of the bit stream, keep it
+// in its register if any and, if visible, write it to the out. Returns the value to
+// be used as routing key.
+template<typename Writer>
+int Engine::decodeField(const Instruction& instruction, Writer& out) {
+    int routingMapKey = 0;
+    BitView bt;
+    if(instruction.bitLength){
+        bt = bitStream.consumeView(instruction.bitLength);
+    } else {
+        // The delimiter is not part of the value
+        bt = bitStream.consumeViewUntill(instruction.delimiter);
+        bitStream.shift(8);
+        // Fixed widths are checked when the schema is compiled
+        bool integer = instruction.type == MessageElement::MessageElementType::MET_INTEGER ||
+                       instruction.type == MessageElement::MessageElementType::MET_UNSIGNED_INTEGER;
+        if(integer && instruction.encoding == MessageElement::NumericEncodingType::NE_BINARY && bt.getLength() > 64){
+            throw std::invalid_argument("Element <" + program->paths[instruction.path].pointer + "> is longer than 64 bits: " + std::to_string(bt.getLength()) + " bit(s)");
+        }
+    }
+    if(instruction.type == MessageElement::MessageElementType::MET_EXTENDED){
+        // The extended field is not contiguous with the field it extends,
+        // so the combined value replaces the one already decoded
+        Register& orig = registers[instruction.reg];
+        if(not orig.set){
+            throw std::invalid_argument("Extended element <" + program->paths[instruction.reference].pointer + "> not found or not yet analyzed");
+        }
+        if(orig.bits + bt.getLength() > 64){
+            throw std::invalid_argument("Element <" + program->paths[instruction.path].pointer + "> extends <" + program->paths[instruction.reference].pointer +
+                                        "> past 64 bits: " + std::to_string(orig.bits + bt.getLength()) + " bit(s)");
+        }
+        uint64_t high = bt.getLength() < 64 ? orig.raw << bt.getLength() : 0;
+        uint64_t value = high | bt.readU64(0, bt.getLength());
+        orig.value = value;
+        if(instruction.visible){
+            bool rewrite = orig.outputLength != 0;
+            size_t start = beginValue(instruction.reference, rewrite, out);
+            out.value(value);
+            endValue(orig, start, rewrite, out);
+        }
+        return static_cast<int>(value);
+    }
+
+    Register scratch;
+    Register& reg = instruction.reg != Instruction::noRegister ? registers[instruction.reg] : scratch;
+    // A field met again at the same place in the output is overwritten
+    bool rewrite = reg.outputLength != 0 && program->paths[instruction.path].arrays == 0;
+    size_t start = instruction.visible ? beginValue(instruction.path, rewrite, out) : 0;
+    if(bt.getLength() <= 64){
+        reg.raw = bt.readU64(0, bt.getLength());
+        reg.bits = bt.getLength();
+    }
+    reg.set = true;
+    reg.type = instruction.type;
+    std::string_view text;
+    switch(instruction.type){
+        case MessageElement::MessageElementType::MET_INTEGER:
+            {
+                int64_t value;
+                if(instruction.encoding == MessageElement::NumericEncodingType::NE_BCD ||
+                   instruction.encoding == MessageElement::NumericEncodingType::NE_ASCII){
+                    bool negative;
+                    uint64_t magnitude = readDigits(instruction, bt, negative);
+                    value = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
                 } else {
-                    analizeElement(elementOfTheMap, newParentPath);            
+                    value = bt.readI64(0, bt.getLength());
                 }
-            } else {
-                // Routing key not found in the map
-                std::string err_message = "Provided the routing key <" + std::to_string(routingMapKey) + "> that has not been configured for element <" + element.getName() + ">";
-                Logger::getInstance().log(err_message, Logger::Level::ERROR);
-                throw std::invalid_argument(err_message);            
+                if(instruction.visible){ out.value(value); }
+                reg.value = static_cast<uint64_t>(value);
+                routingMapKey = static_cast<int>(value);
+                break;
             }
+        case MessageElement::MessageElementType::MET_UNSIGNED_INTEGER:
+            {
+                uint64_t value;
+                if(instruction.encoding == MessageElement::NumericEncodingType::NE_BCD ||
+                   instruction.encoding == MessageElement::NumericEncodingType::NE_ASCII){
+                    bool negative;
+                    value = readDigits(instruction, bt, negative);
+                } else {
+                    value = bt.readU64(0, bt.getLength());
+                }
+                if(instruction.visible){ out.value(value); }
+                reg.value = value;
+                routingMapKey = static_cast<int>(value);
+                break;
+            }
+        case MessageElement::MessageElementType::MET_DECIMAL:
+            {
+                double value = bt.to_double(instruction.bitLength);
+                if(instruction.visible){ out.value(value); }
+                reg.decimal = value;
+                break;
+            }
+        case MessageElement::MessageElementType::MET_STRING:
+            {
+                bool retained = &reg != &scratch;
+                bool filtered = filter != nullptr && filter->watches(instruction.path);
+                if(not instruction.visible && not retained && not filtered){ break; }
+                if((bt.getOffset() % 8) == 0 && (bt.getLength() % 8) == 0){
+                    text = std::string_view(reinterpret_cast<const char*>(bt.getData() + (bt.getOffset() >> 3)), bt.getLengthInBytes());
+                } else {
+                    char* copy = arena.allocate<char>(bt.getLengthInBytes());
+                    bt.copyTo(reinterpret_cast<unsigned char*>(copy));
+                    text = std::string_view(copy, bt.getLengthInBytes());
+                }
+                if(instruction.visible){ out.value(text.data(), text.size()); }
+                if(retained){ reg.text.assign(text.data(), text.size()); }
+                break;
+            }
+        case MessageElement::MessageElementType::MET_BOOLEAN:
+            {
+                bool value = bt.to_boolean();
+                if(instruction.visible){ out.value(value); }
+                reg.value = value ? 1 : 0;
+                break;
+            }
+        default:
+            Logger::getInstance().log("Usupported type <" + MessageElement::MessageElementTypeToString(instruction.type) + "> for field with name: " + program->paths[instruction.path].pointer, Logger::Level::ERROR);
+            throw std::invalid_argument("Usupported type <" + MessageElement::MessageElementTypeToString(instruction.type) + "> for field with name: " + program->paths[instruction.path].pointer);
+    }
+    if(filter != nullptr && filter->watches(instruction.path) && not filterField(instruction.path, reg, text)){
+        rejected = true;
+        return routingMapKey;
+    }
+    if(instruction.visible){
+        endValue(reg, start, rewrite, out);
+    }
+    return routingMapKey;
+}
+
+// Value of an integer written as decimal digits: BCD nibbles, or ASCII
+// characters led by '-' for a negative integer
+uint64_t Engine::readDigits(const Instruction& instruction, const BitView& bt, bool& negative){
+    bool ascii = instruction.encoding == MessageElement::NumericEncodingType::NE_ASCII;
+    unsigned int unit = ascii ? 8 : 4;
+    size_t count = bt.getLength() / unit;
+    negative = false;
+    if(bt.getLength() % unit == 0 && count <= Digits::maxDigits + 1){
+        unsigned char aligned[Digits::maxDigits + 1];
+        const unsigned char* digits = bt.getData() + (bt.getOffset() >> 3);
+        if(bt.getOffset() % 8){
+            bt.copyAlignedTo(aligned);
+            digits = aligned;
+        }
+        if(ascii && count > 1 && digits[0] == '-' && instruction.type == MessageElement::MessageElementType::MET_INTEGER){
+            negative = true;
+            digits++;
+            count--;
+        }
+        uint64_t value;
+        if(ascii ? Digits::parseAscii(reinterpret_cast<const char*>(digits), count, value) : Digits::parseBcd(digits, count, value)){
+            return value;
         }
     }
+    throw std::invalid_argument("Invalid " + std::string(ascii ? "ASCII" : "BCD") + " digits for element <" + program->paths[instruction.path].pointer + ">");
 }
 
-bool Engine::evaluateExistingConditions(const std::vector<MessageElementExistingCondition>& conditions){
-    if(conditions.size()==0){
-        return true;
+// As decodeField() for a field of an OP_BLOCK, whose bits have already
+// been read: the value is the same that decodeField() gets from them
+template<typename Writer>
+void Engine::decodeFixed(const Instruction& instruction, uint64_t raw, Writer& out) {
+    Register scratch;
+    Register& reg = instruction.reg != Instruction::noRegister ? registers[instruction.reg] : scratch;
+    bool rewrite = reg.outputLength != 0 && program->paths[instruction.path].arrays == 0;
+    size_t start = instruction.visible ? beginValue(instruction.path, rewrite, out) : 0;
+    reg.raw = raw;
+    reg.bits = instruction.bitLength;
+    reg.set = true;
+    reg.type = instruction.type;
+    switch(instruction.type){
+        case MessageElement::MessageElementType::MET_INTEGER:
+            {
+                unsigned int unused = 64 - instruction.bitLength;
+                int64_t value = static_cast<int64_t>(raw << unused) >> unused;
+                if(instruction.visible){ out.value(value); }
+                reg.value = static_cast<uint64_t>(value);
+                break;
+            }
+        case MessageElement::MessageElementType::MET_UNSIGNED_INTEGER:
+            if(instruction.visible){ out.value(raw); }
+            reg.value = raw;
+            break;
+        case MessageElement::MessageElementType::MET_DECIMAL:
+            {
+                double value;
+                if(instruction.bitLength == 32){
+                    uint32_t bits = static_cast<uint32_t>(raw);
+                    float single;
+                    std::memcpy(&single, &bits, sizeof(single));
+                    value = single;
+                } else {
+                    std::memcpy(&value, &raw, sizeof(value));
+                }
+                if(instruction.visible){ out.value(value); }
+                reg.decimal = value;
+                break;
+            }
+        default:
+            if(instruction.visible){ out.value(raw != 0); }
+            reg.value = raw != 0 ? 1 : 0;
+            break;
     }
-    for(auto& condition : conditions){
-        if(jsonFlatten.count(condition.getRefField())!=0){
-            nlohmann::json field = jsonFlatten[condition.getRefField()];
-            nlohmann::json value = condition.getRefValue();
-            if(condition.getCondition() == MessageElementExistingCondition::MessageElementExistingConditionType::DCT_EQUAL &&
-                jsonFlatten[condition.getRefField()].get<bool>()==false ){
-                Logger::getInstance().log("Condition not met on field: " + condition.getRefField(), Logger::Level::DEBUG);
-                return false;
+    if(filter != nullptr && filter->watches(instruction.path) && not filterField(instruction.path, reg, std::string_view())){
+        rejected = true;
+        return;
+    }
+    if(instruction.visible){
+        endValue(reg, start, rewrite, out);
+    }
+}
+
+// A value is always written at the end of the output: when it replaces one
+// already written it is then moved in its place
+template<typename Writer>
+size_t Engine::beginValue(uint32_t path, bool rewrite, Writer& out){
+    if constexpr(std::is_same_v<Writer, ColumnarSink>){
+        // The column and the row take the place of the position in the output
+        out.field(path, indices);
+        return 0;
+    } else {
+        if(not rewrite){
+            openMember(path, out);
+        }
+        return out.size();
+    }
+}
+
+template<typename Writer>
+void Engine::endValue(Register& reg, size_t start, bool rewrite, Writer& out){
+    if constexpr(std::is_same_v<Writer, ColumnarSink>){
+        return;
+    } else {
+        if(not rewrite){
+            reg.outputOffset = start;
+            reg.outputLength = out.size() - start;
+            return;
+        }
+        size_t length = out.size() - start;
+        char* text = arena.allocate<char>(length);
+        std::memcpy(text, out.str().data() + start, length);
+        out.truncate(start);
+        out.replace(reg.outputOffset, reg.outputLength, text, length);
+        // Values written after the replaced one have moved
+        for(auto& other : registers){
+            if(other.outputOffset > reg.outputOffset){
+                other.outputOffset = other.outputOffset + length - reg.outputLength;
             }
-        } else if(condition.getCondition() == MessageElementExistingCondition::MessageElementExistingConditionType::DCT_EXIST){
+        }
+        reg.outputLength = length;
+    }
+}
+
+// Existing conditions checked against the fields already decoded: a
+// condition on a field that has not been decoded is not met
+bool Engine::evaluateConditions(const std::vector<CompiledCondition>& conditions){
+    for(const auto& condition : conditions){
+        const Register& reg = registers[condition.reg];
+        bool met = reg.set ? holds(condition.predicate, reg, reg.text) : condition.predicate.missing();
+        if(not met){
             return false;
         }
     }
     return true;
 }
 
-void Engine::analizeStructure(const std::vector<MessageElement>& structure, const std::string& parentPath){
-    Logger::getInstance().log("Evaluating a structure of "+
-                              std::to_string(structure.size()) + " elements", Logger::Level::DEBUG);
-    for (auto it = structure.begin(); it != structure.end(); ++it) {
-        Logger::getInstance().log("Evaluating element <" + it->getName() +
-                                  "> as a <" + MessageElement::MessageElementTypeToString(it->getType()) + ">" +
-                                  " of <" + std::to_string(it->getBitLength()) + "> bit(s) from bit <"+ std::to_string(bitStream->getOffset()) + ">", Logger::Level::DEBUG);
-        
-        if(it->getType() == MessageElement::MessageElementType::MET_STRUCTURE){ 
-            if(it->isArray()){
-                int repetitions = it->getRepetitions(); 
-                if(repetitions==0) {
-                    Logger::getInstance().log("Evaluating reference as array repetitions <" + it->getRepetitionsReference() + ">", Logger::Level::DEBUG);
-                    if (jsonFlatten.contains(it->getRepetitionsReference())) {
-                        repetitions = jsonFlatten[it->getRepetitionsReference()].get<unsigned int>();
-                    } else {
-                        Logger::getInstance().log("Repetitions reference not found or not yet analyzed", Logger::Level::ERROR);
-                        Logger::getInstance().log(jsonFlatten.dump(), Logger::Level::DEBUG);
-                        throw std::invalid_argument("Repetitions reference <" + it->getRepetitionsReference() + "> not found or not yet analyzed");
-                    }
-                }
-                Logger::getInstance().log("Repetitions <" + std::to_string(repetitions) + ">", Logger::Level::DEBUG);
-                it->forceIsArray(false);  // force to evaluate the element N times
-                for(int i=0; i < repetitions || repetitions==-1; i++){
-                    analizeStructure(it->getStructure(), parentPath + "/" + std::to_string(i));
-                    if(not bitStream->remainingBits()) break;
-                }
-            } else {
-                std::string newParentPath = parentPath;    
-                if(not it->isFlattenStructure()){
-                    newParentPath += "/" + it->getName();
-                } 
-                analizeStructure(it->getStructure(), newParentPath);    
-            }        
-        } else {
-            analizeElement(*it, parentPath + "/" + it->getName());
+// Check 'predicate' on the value of a decoded field, 'text' for strings
+bool Engine::holds(const ConditionPredicate& predicate, const Register& reg, std::string_view text){
+    switch(reg.type){
+        case MessageElement::MessageElementType::MET_INTEGER:
+            return predicate.test(ConditionPredicate::Number::of(static_cast<int64_t>(reg.value)));
+        case MessageElement::MessageElementType::MET_DECIMAL:
+            return predicate.test(ConditionPredicate::Number::of(reg.decimal));
+        case MessageElement::MessageElementType::MET_STRING:
+            return predicate.test(text);
+        default:
+            return predicate.test(ConditionPredicate::Number::of(reg.value));
+    }
+}
+
+// Clauses of the filter on the field just read
+bool Engine::filterField(uint32_t path, const Register& reg, std::string_view text){
+    for(uint32_t index = filter->first(path); index < filter->last(path); index++){
+        filterSeen[index] = 1;
+        if(not holds(filter->clause(index).predicate, reg, text)){
+            return false;
+        }
+    }
+    return true;
+}
+
+// At the end of the message: the clauses on fields never read fail, the
+// deferred ones are checked on the final value of their field
+bool Engine::filterMessage(){
+    for(size_t index = 0; index < filter->size(); index++){
+        const MessageFilter::Clause& clause = filter->clause(index);
+        if(clause.deferred){
+            const Register& reg = registers[clause.reg];
+            if(not reg.set || not holds(clause.predicate, reg, reg.text)){
+                return false;
+            }
+        } else if(not filterSeen[index]){
+            return false;
         }
     }
+    return true;
 }
 
 std::string Engine::getTypeString(nlohmann::json::value_t type) {
@@ -515,4 +1342,12 @@ std::string Engine::getTypeString(nlohmann::json::value_t type) {
         default:
             return "unknown";
     }
-}
\ No newline at end of file
+}
+// Number of bytes needed by a value written in a delimited (variable length) field
+unsigned int Engine::minimumBytes(uint64_t value) {
+    unsigned int bytes = 1;
+    while(bytes < 8 && (value >> (bytes * 8))){
+        bytes++;
+    }
+    return bytes;
+}
@@ -0,0 +1,81 @@
+#include "FieldTable.h"
+
+std::shared_ptr<const FieldTable> FieldTable::build(const std::vector<MessageElement>& structure){
+    auto table = std::make_shared<FieldTable>();
+    table->intern("");
+    table->rootCount = static_cast<uint32_t>(structure.size());
+    table->place(structure);
+    return table;
+}
+
+uint32_t FieldTable::intern(const std::string& value){
+    auto it = nameIndex.find(value);
+    if(it != nameIndex.end()){
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(names.size());
+    names.push_back(value);
+    nameIndex.emplace(value, id);
+    return id;
+}
+
+// Reserve a contiguous block for 'elements', then fill it: the descendants of
+// each element are placed after the block
+uint32_t FieldTable::place(const std::vector<MessageElement>& elements){
+    uint32_t first = static_cast<uint32_t>(fields.size());
+    fields.resize(first + elements.size());
+    for(size_t i = 0; i < elements.size(); i++){
+        fill(first + static_cast<uint32_t>(i), elements[i]);
+    }
+    return first;
+}
+
+void FieldTable::fill(uint32_t index, const MessageElement& element){
+    // 'fields' grows while the children are placed: the descriptor is
+    // completed locally and stored at the end
+    FieldDescriptor field;
+    field.type = element.getType();
+    field.encoding = element.getNumericEncoding();
+    field.name = intern(element.getName());
+    field.bitLength = static_cast<uint32_t>(element.getBitLength());
+    field.delimiter = element.getDelimiter();
+    field.repetitions = element.getRepetitions();
+    field.repetitionsReference = intern(element.getRepetitionsReference());
+    field.extend = intern(element.getExtendElement());
+    field.visible = element.isVisible();
+    field.delimited = element.isDelimited();
+    field.array = element.isArray();
+    field.flatten = element.isFlattenStructure();
+
+    const auto& existingConditions = element.getExistingConditions();
+    field.firstCondition = static_cast<uint32_t>(conditions.size());
+    field.conditionCount = static_cast<uint32_t>(existingConditions.size());
+    for(const auto& condition : existingConditions){
+        conditions.push_back(FieldCondition{intern(condition.getRefField()), ConditionPredicate(condition)});
+    }
+
+    if(field.type == MessageElement::MessageElementType::MET_STRUCTURE){
+        field.childCount = static_cast<uint32_t>(element.getStructure().size());
+        field.firstChild = place(element.getStructure());
+    }
+
+    const auto& routing = element.getRouting();
+    field.firstRoute = static_cast<uint32_t>(routes.size());
+    field.routeCount = static_cast<uint32_t>(routing.size());
+    routes.resize(routes.size() + routing.size());
+    uint32_t route = field.firstRoute;
+    std::vector<std::pair<int, uint32_t>> dispatch;
+    for(const auto& [key, target] : routing){
+        uint32_t targetIndex = static_cast<uint32_t>(fields.size());
+        fields.emplace_back();
+        fill(targetIndex, target);
+        routes[route++] = FieldRoute{key, targetIndex};
+        dispatch.emplace_back(key, targetIndex);
+    }
+    if(not dispatch.empty()){
+        field.routingTable = static_cast<uint32_t>(routingTables.size());
+        routingTables.emplace_back(dispatch);
+    }
+
+    fields[index] = field;
+}
@@ -0,0 +1,92 @@
+#include "JsonIndex.h"
+
+using nlohmann::json;
+
+void JsonIndex::appendKey(std::string& pointer, std::string_view key){
+    pointer += '/';
+    if(key.find_first_of("~/") == std::string_view::npos){
+        pointer += key;
+        return;
+    }
+    for(char c : key){
+        if(c == '~'){
+            pointer += "~0";
+        } else if(c == '/'){
+            pointer += "~1";
+        } else {
+            pointer += c;
+        }
+    }
+}
+
+void JsonIndex::clear(){
+    values.clear();
+    pointers.clear();
+    texts.clear();
+    byPointer.clear();
+    usedCount = 0;
+}
+
+void JsonIndex::add(std::string_view pointer, Value value, std::string_view text){
+    value.pointer = static_cast<uint32_t>(pointers.size());
+    value.pointerLength = static_cast<uint32_t>(pointer.size());
+    value.used = false;
+    if(value.type == json::value_t::string){
+        value.text = static_cast<uint32_t>(texts.size());
+        value.textLength = static_cast<uint32_t>(text.size());
+        texts += text;
+    }
+    pointers += pointer;
+    // A key repeated in an object keeps its first value
+    byPointer.emplace(pointer, static_cast<uint32_t>(values.size()));
+    values.push_back(value);
+}
+
+const JsonIndex::Value* JsonIndex::take(std::string_view pointer){
+    if(unused() == 0){
+        return nullptr;
+    }
+    auto it = byPointer.find(std::string(pointer));
+    if(it == byPointer.end()){
+        return nullptr;
+    }
+    Value& value = values[it->second];
+    if(not value.used){
+        value.used = true;
+        usedCount++;
+    }
+    return &value;
+}
+
+bool JsonIndex::contains(std::string_view prefix) const {
+    if(unused() == 0){
+        return false;
+    }
+    for(const auto& value : values){
+        std::string_view at = pointer(value);
+        if(not value.used && at.compare(0, prefix.size(), prefix) == 0 &&
+           (at.size() == prefix.size() || at[prefix.size()] == '/')){
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string JsonIndex::toString(bool unusedOnly) const {
+    nlohmann::ordered_json out = nlohmann::ordered_json::object();
+    for(const auto& value : values){
+        if(unusedOnly && value.used){
+            continue;
+        }
+        nlohmann::ordered_json& item = out[std::string(pointer(value))];
+        switch(value.type){
+            case json::value_t::boolean: item = value.boolean; break;
+            case json::value_t::number_integer: item = value.integer; break;
+            case json::value_t::number_unsigned: item = value.unsignedInteger; break;
+            case json::value_t::number_float: item = value.decimal; break;
+            case json::value_t::string: item = std::string(text(value)); break;
+            default: break;
+        }
+    }
+    return out.dump();
+}
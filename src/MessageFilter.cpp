@@ -0,0 +1,102 @@
+#include "MessageFilter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <stdexcept>
+
+std::shared_ptr<const MessageFilter> MessageFilter::compile(const SchemaProgram& program, const std::vector<std::string>& expressions){
+    auto filter = std::make_shared<MessageFilter>();
+    for(const auto& expression : expressions){
+        filter->clauses.push_back(parse(program, expression));
+    }
+    std::stable_sort(filter->clauses.begin(), filter->clauses.end(), [](const Clause& a, const Clause& b){
+        return a.deferred != b.deferred ? b.deferred : a.path < b.path;
+    });
+    filter->offsets.assign(program.paths.size() + 1, 0);
+    for(const auto& clause : filter->clauses){
+        if(not clause.deferred){
+            filter->offsets[clause.path + 1]++;
+        }
+        const std::string& pointer = program.paths[clause.path].pointer;
+        if(std::find(filter->fieldPointers.begin(), filter->fieldPointers.end(), pointer) == filter->fieldPointers.end()){
+            filter->fieldPointers.push_back(pointer);
+        }
+    }
+    for(size_t path = 1; path < filter->offsets.size(); path++){
+        filter->offsets[path] += filter->offsets[path - 1];
+    }
+    return filter;
+}
+
+MessageFilter::Clause MessageFilter::parse(const SchemaProgram& program, const std::string& expression){
+    static const std::map<std::string, std::string> symbols = {
+        {"==", "eq"}, {"!=", "neq"}, {"<", "lt"}, {"<=", "lte"}, {">", "gt"}, {">=", "gte"}
+    };
+    auto invalid = [&expression](const std::string& reason){
+        return std::invalid_argument("Invalid filter <" + expression + ">: " + reason);
+    };
+    auto space = [](char c){ return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    auto symbol = [](char c){ return c == '=' || c == '!' || c == '<' || c == '>'; };
+
+    size_t position = 0;
+    auto skipSpaces = [&](){
+        while(position < expression.size() && space(expression[position])){ position++; }
+    };
+    skipSpaces();
+    size_t start = position;
+    while(position < expression.size() && not space(expression[position]) && not symbol(expression[position])){ position++; }
+    std::string pointer = expression.substr(start, position - start);
+    if(not pointer.empty() && pointer[0] != '/'){
+        pointer = "/" + pointer;
+    }
+    skipSpaces();
+    start = position;
+    if(position < expression.size() && symbol(expression[position])){
+        while(position < expression.size() && symbol(expression[position])){ position++; }
+    } else {
+        while(position < expression.size() && not space(expression[position])){ position++; }
+    }
+    std::string operation = expression.substr(start, position - start);
+    skipSpaces();
+    std::string value = expression.substr(position);
+    while(not value.empty() && space(value.back())){ value.pop_back(); }
+
+    auto path = std::find_if(program.paths.begin(), program.paths.end(), [&pointer](const FieldPath& path){ return path.pointer == pointer; });
+    if(pointer.size() < 2 || path == program.paths.end()){
+        throw invalid("<" + pointer + "> is not a field of the schema");
+    }
+    auto it = symbols.find(operation);
+    std::string name = it != symbols.end() ? it->second : operation;
+    auto type = MessageElementExistingCondition::stringToMessageElementExistingConditionType(name);
+    if(type == ConditionPredicate::Type::DCT_UNDEFINED || type == ConditionPredicate::Type::DCT_EXIST){
+        throw invalid("unknown operator <" + operation + ">");
+    }
+    if(value.empty()){
+        throw invalid("missing value");
+    }
+    // JSON has no hexadecimal numbers
+    if(value.size() > 2 && value[0] == '0' && (value[1] == 'x' || value[1] == 'X') &&
+       std::all_of(value.begin() + 2, value.end(), [](char c){ return std::isxdigit(static_cast<unsigned char>(c)) != 0; })){
+        value = std::to_string(std::stoull(value.substr(2), nullptr, 16));
+    }
+
+    Clause clause{static_cast<uint32_t>(path - program.paths.begin()), Instruction::noRegister, false,
+                  ConditionPredicate(MessageElementExistingCondition(pointer, value, type)), expression};
+    if(clause.predicate.getType() == ConditionPredicate::Type::DCT_UNDEFINED){
+        throw invalid("unsupported value <" + value + ">");
+    }
+    for(const auto& instruction : program.code){
+        if(instruction.op == Instruction::OpCode::OP_EXTEND && instruction.path == clause.path){
+            throw invalid("<" + pointer + "> extends <" + program.paths[instruction.reference].pointer + ">: filter on that field");
+        }
+        if(instruction.op == Instruction::OpCode::OP_FIELD && instruction.path == clause.path){
+            clause.reg = instruction.reg;
+        }
+    }
+    // A field outside of the arrays that is kept in a register may change
+    // later (extended, or read again in the same place): its value is final
+    // only at the end of the message
+    clause.deferred = program.paths[clause.path].arrays == 0 && clause.reg != Instruction::noRegister;
+    return clause;
+}
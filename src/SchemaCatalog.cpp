@@ -10,6 +10,37 @@ Schema* SchemaCatalog::getSchema(const std::string& name) {
     return nullptr;
 }
 
+// Program of the schema decoding only the fields at 'pointers' (see
+// SchemaProgram::project()), compiled on the first request and shared by
+// the following ones. Throws when the schema does not exist or a pointer
+// does not match any of its fields.
+std::shared_ptr<const SchemaProgram> SchemaCatalog::getProjection(const std::string& name, const std::vector<std::string>& pointers,
+                                                                  const std::vector<std::string>& needed) {
+    Schema* schema = getSchema(name);
+    if(schema == nullptr){
+        throw std::invalid_argument("Requested schema <" + name + "> does not exist in the loaded catalog");
+    }
+    std::string key = name + '\0';
+    for(const auto& pointer : pointers){
+        key += pointer + '\0';
+    }
+    key += '\1';
+    for(const auto& pointer : needed){
+        key += pointer + '\0';
+    }
+    std::lock_guard<std::mutex> lock(projectionsMutex);
+    auto it = projections.find(key);
+    if(it != projections.end()){
+        return it->second;
+    }
+    auto projection = schema->program->project(pointers, needed);
+    if(projections.size() >= maxProjections){
+        projections.clear();
+    }
+    projections[key] = projection;
+    return projection;
+}
+
 
 std::vector<MessageElementExistingCondition> SchemaCatalog::parseJsonMessageElementExistingConditions(json json_value){
     std::vector<MessageElementExistingCondition> conditions;
@@ -31,8 +62,12 @@ std::vector<MessageElementExistingCondition> SchemaCatalog::parseJsonMessageElem
         if(elem.contains("condition") && elem["condition"].type() == json::value_t::string){
             cond = elem["condition"].get<std::string>();
         }
+        // Other reference values are kept as JSON text, parsed when the
+        // condition is compiled
         if(elem.contains("ref_value") && elem["ref_value"].type() == json::value_t::string){
             ref_value = elem["ref_value"].get<std::string>();
+        } else if(elem.contains("ref_value")){
+            ref_value = elem["ref_value"].dump();
         }
         MessageElementExistingCondition condition(ref_field, ref_value,
             MessageElementExistingCondition::stringToMessageElementExistingConditionType(cond));
@@ -111,10 +146,89 @@ std::map<int, MessageElement> SchemaCatalog::parseJsonMessageElementRouting(json
     return msgRouting;
 }
 
+// An invalid <framing> section is logged and ignored: the schema can still
+// be used for single messages
+Framing SchemaCatalog::parseJsonFraming(json json_value, const SchemaProgram& program, const std::string& name){
+    Framing framing;
+    if(json_value.is_null()){
+        size_t bits = program.fixedBitLength();
+        if(bits){
+            framing.type = Framing::Type::FIXED;
+            framing.byteLength = (bits + 7) >> 3;
+        }
+        return framing;
+    }
+    std::string error;
+    try {
+        std::string type = json_value.value("type", "");
+        if(type == "fixed"){
+            framing.type = Framing::Type::FIXED;
+            framing.byteLength = json_value.value("byte_length", size_t(0));
+            if(framing.byteLength == 0){
+                error = "missing <byte_length>";
+            }
+        } else if(type == "length"){
+            framing.type = Framing::Type::LENGTH;
+            std::string field = json_value.value("field", "");
+            if(not program.fixedPosition(field, framing.lengthOffset, framing.lengthBits) || framing.lengthBits > 64){
+                error = "length field <" + field + "> is not a field of at most 64 bits at a fixed position";
+            }
+            framing.lengthUnit = json_value.value("unit", int64_t(1));
+            framing.lengthAdjustment = json_value.value("adjustment", int64_t(0));
+        } else if(type == "terminator"){
+            framing.type = Framing::Type::TERMINATOR;
+            framing.terminator = json_value.value("terminator", "");
+            framing.trailerLength = json_value.value("trailer_length", size_t(0));
+            if(framing.terminator.empty()){
+                error = "missing <terminator>";
+            }
+        } else {
+            error = "unsupported type <" + type + ">";
+        }
+    } catch (const json::exception& e) {
+        error = e.what();
+    }
+    if(not error.empty()){
+        Logger::getInstance().log("Invalid framing in schema <" + name + ">: " + error, Logger::Level::ERROR);
+        return Framing();
+    }
+    return framing;
+}
+
+size_t SchemaCatalog::estimateBitLength(const std::vector<MessageElement>& structure){
+    size_t bits = 0;
+    for(const auto& element : structure){
+        bits += estimateBitLength(element);
+    }
+    return bits;
+}
+
+// Bits taken by an element: arrays sized by a reference count as one
+// repetition, delimited fields as their delimiter only and a routed element
+// as its largest alternative
+size_t SchemaCatalog::estimateBitLength(const MessageElement& element){
+    size_t bits = 0;
+    if(element.getType() == MessageElement::MessageElementType::MET_STRUCTURE){
+        bits = estimateBitLength(element.getStructure());
+    } else {
+        bits = element.isDelimited() ? 8 : element.getBitLength();
+        size_t routed = 0;
+        for(const auto& [key, target] : element.getRouting()){
+            routed = std::max(routed, estimateBitLength(target));
+        }
+        bits += routed;
+    }
+    if(element.isArray() && element.getRepetitions() > 1){
+        bits *= element.getRepetitions();
+    }
+    return bits;
+}
+
 std::map<std::string, Schema> SchemaCatalog::addConfiguration(const std::string& file_str, const std::string& name){
     json json_value = json::parse(file_str);
     Schema schema;
     schema.catalogName = name;
+    json framing;
     if(json_value.is_object()){
        for (const auto& [key, val] : json_value.items()) {
             if(key=="structure" && val.type() == json::value_t::array){
@@ -131,6 +245,8 @@ std::map<std::string, Schema> SchemaCatalog::addConfiguration(const std::string&
                 schema.metadata = metadata;
             } else if(key=="version" && val.type() == json::value_t::string){
                 schema.version = val.get<std::string>();
+            } else if(key=="framing" && val.type() == json::value_t::object){
+                framing = val;
             } else {
                 Logger::getInstance().log("Unsupported type: " + std::to_string(static_cast<int>(json_value.type())) + " for element named <" + key + "> in file <" + name + ">", Logger::Level::WARNING);
             }
@@ -138,10 +254,50 @@ std::map<std::string, Schema> SchemaCatalog::addConfiguration(const std::string&
     } else {
         Logger::getInstance().log("Provided JSON is not an object", Logger::Level::ERROR);
     } 
+    schema.bitLengthHint = estimateBitLength(schema.structure);
+    schema.fields = FieldTable::build(schema.structure);
+    schema.program = SchemaProgram::compile(*schema.fields);
+    schema.framing = parseJsonFraming(framing, *schema.program, name);
+    Logger::getInstance().log("Compiled schema <" + name + ">:\n" + schema.program->toString(), Logger::Level::DEBUG);
+    schema.fingerprint = GeneratedCodec::fingerprintOf(json_value);
+    attachGeneratedCodec(schema);
+    {
+        // Projections of the previous version of the schema
+        std::lock_guard<std::mutex> lock(projectionsMutex);
+        auto it = projections.lower_bound(name + '\0');
+        while(it != projections.end() && it->first.compare(0, name.size() + 1, name + '\0') == 0){
+            it = projections.erase(it);
+        }
+    }
     schemaMap[name] = schema;
     return schemaMap;
 }
 
+// Generated code registers itself before or after the catalog is loaded
+bool SchemaCatalog::registerGeneratedCodec(const GeneratedCodec* codec){
+    generatedCodecs[codec->schema] = codec;
+    auto it = schemaMap.find(codec->schema);
+    if(it != schemaMap.end()){
+        attachGeneratedCodec(it->second);
+    }
+    return true;
+}
+
+// Use the generated code only if it matches the schema as loaded
+void SchemaCatalog::attachGeneratedCodec(Schema& schema){
+    schema.generated = nullptr;
+    auto it = generatedCodecs.find(schema.catalogName);
+    if(it == generatedCodecs.end()){
+        return;
+    }
+    if(it->second->fingerprint != schema.fingerprint){
+        Logger::getInstance().log("Generated code for schema <" + schema.catalogName + "> does not match the loaded schema: using the interpreter", Logger::Level::WARNING);
+        return;
+    }
+    schema.generated = it->second;
+    Logger::getInstance().log("Using generated code for schema <" + schema.catalogName + ">", Logger::Level::INFO);
+}
+
 std::string SchemaCatalog::printMessageElementList(const std::vector<MessageElement>& vec) {
     std::ostringstream oss;
     oss << "{\"structure\" : [";
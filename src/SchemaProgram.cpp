@@ -0,0 +1,549 @@
+#include "SchemaProgram.h"
+
+#include <algorithm>
+#include <sstream>
+
+std::shared_ptr<const SchemaProgram> SchemaProgram::compile(const FieldTable& table){
+    auto program = std::make_shared<SchemaProgram>();
+    program->context.assign(1, "");
+    program->compileStructure(table, 0, table.rootCount);
+    program->emit(Instruction(Instruction::OpCode::OP_END));
+    program->allocateRegisters();
+    program->findFixedBlocks();
+    program->context.clear();
+    program->pathIndex.clear();
+    program->keyIndex.clear();
+    return program;
+}
+
+uint32_t SchemaProgram::emit(Instruction instruction){
+    code.push_back(std::move(instruction));
+    return static_cast<uint32_t>(code.size() - 1);
+}
+
+// ID of the path of the field 'name' in the current context
+uint32_t SchemaProgram::internPath(const std::string& name){
+    std::string pointer;
+    for(size_t i = 0; i < context.size(); i++){
+        pointer += (i ? "*" : "") + context[i];
+    }
+    if(not name.empty()){
+        pointer += "/" + name;
+    }
+    auto it = pathIndex.find(pointer);
+    if(it != pathIndex.end()){
+        return it->second;
+    }
+    return addPath(pointer);
+}
+
+// References are written as JSON pointers to a field that precedes them.
+// A reference to any other path still gets an ID, that is never set.
+uint32_t SchemaProgram::resolvePath(const std::string& pointer){
+    auto it = pathIndex.find(pointer);
+    if(it != pathIndex.end()){
+        return it->second;
+    }
+    Logger::getInstance().log("Reference <" + pointer + "> does not match any preceding field", Logger::Level::WARNING);
+    return addPath(pointer);
+}
+
+// Split the pointer into segments, rendering each key once for the output
+uint32_t SchemaProgram::addPath(const std::string& pointer){
+    FieldPath path;
+    path.pointer = pointer;
+    size_t start = pointer.empty() || pointer[0] != '/' ? 0 : 1;
+    while(start <= pointer.size()){
+        size_t end = pointer.find('/', start);
+        if(end == std::string::npos){ end = pointer.size(); }
+        std::string token = pointer.substr(start, end - start);
+        if(token == "*"){
+            path.segments.push_back(PathSegment{true, path.arrays++});
+        } else {
+            auto key = keyIndex.find(token);
+            if(key == keyIndex.end()){
+                key = keyIndex.emplace(token, static_cast<uint32_t>(keys.size())).first;
+                names.push_back(token);
+                keys.push_back(JsonWriter::renderKey(token));
+                cborKeys.push_back(CborWriter::renderKey(token));
+                msgpackKeys.push_back(MsgPackWriter::renderKey(token));
+            }
+            path.segments.push_back(PathSegment{false, key->second});
+        }
+        start = end + 1;
+    }
+    uint32_t id = static_cast<uint32_t>(paths.size());
+    pathIndex.emplace(pointer, id);
+    paths.push_back(std::move(path));
+    return id;
+}
+
+void SchemaProgram::compileStructure(const FieldTable& table, uint32_t first, uint32_t count){
+    for(uint32_t i = first; i < first + count; i++){
+        compileElement(table, table.fields[i], false);
+    }
+}
+
+// Output paths follow the tree: a structure adds its name unless flattened,
+// an array of fields its name and then the index of every item. Arrays of
+// structures add only the index, unless they are the target of a routing.
+void SchemaProgram::compileElement(const FieldTable& table, const FieldDescriptor& element, bool routed){
+    std::vector<std::string> parent = context;
+    uint32_t guard = 0;
+    bool guarded = element.conditionCount > 0;
+    if(guarded){
+        std::vector<CompiledCondition> set;
+        for(uint32_t i = element.firstCondition; i < element.firstCondition + element.conditionCount; i++){
+            const auto& condition = table.conditions[i];
+            set.push_back(CompiledCondition{resolvePath(table.name(condition.reference)), Instruction::noRegister, condition.predicate});
+        }
+        conditions.push_back(std::move(set));
+        Instruction condition(Instruction::OpCode::OP_CONDITION);
+        condition.table = static_cast<uint32_t>(conditions.size() - 1);
+        guard = emit(condition);
+    }
+
+    bool isStructure = element.type == MessageElement::MessageElementType::MET_STRUCTURE;
+    bool push = element.array;
+    if(isStructure){
+        push = not element.flatten && (routed || not element.array);
+    }
+    if(push){
+        context.back() += "/" + table.name(element.name);
+    }
+
+    uint32_t loop = 0;
+    if(element.array){
+        Instruction begin(Instruction::OpCode::OP_LOOP);
+        begin.repetitions = element.repetitions;
+        begin.reference = element.repetitions == 0 ? resolvePath(table.name(element.repetitionsReference)) : 0;
+        loop = emit(begin);
+        context.back() += "/";
+        context.push_back("");
+        code[loop].path = internPath("");
+    }
+
+    if(isStructure){
+        compileStructure(table, element.firstChild, element.childCount);
+    } else {
+        compileField(table, element, element.array ? "" : table.name(element.name));
+    }
+
+    if(element.array){
+        Instruction next(Instruction::OpCode::OP_NEXT);
+        next.jump = loop;
+        emit(next);
+        code[loop].jump = static_cast<uint32_t>(code.size());
+    }
+    if(guarded){
+        code[guard].jump = static_cast<uint32_t>(code.size());
+    }
+    context = std::move(parent);
+}
+
+// Routed elements are laid out right after the OP_ROUTE that selects them,
+// each one followed by a jump to the instruction after the last of them
+void SchemaProgram::compileField(const FieldTable& table, const FieldDescriptor& element, const std::string& name){
+    bool extended = element.type == MessageElement::MessageElementType::MET_EXTENDED;
+    Instruction field(extended ? Instruction::OpCode::OP_EXTEND : Instruction::OpCode::OP_FIELD);
+    field.type = element.type;
+    field.encoding = element.encoding;
+    field.visible = element.visible;
+    field.delimited = element.delimited;
+    field.bitLength = element.bitLength;
+    field.delimiter = element.delimiter;
+    field.path = internPath(name);
+    field.reference = extended ? resolvePath(table.name(element.extend)) : 0;
+    // Binary integers, and the fields they are extended with, are read into 64 bits
+    bool integer = element.type == MessageElement::MessageElementType::MET_INTEGER ||
+                   element.type == MessageElement::MessageElementType::MET_UNSIGNED_INTEGER;
+    uint32_t width = element.bitLength;
+    if(extended){
+        auto base = std::find_if(code.rbegin(), code.rend(), [&field](const Instruction& instruction){
+            return instruction.op == Instruction::OpCode::OP_FIELD && instruction.path == field.reference;
+        });
+        width += base != code.rend() ? base->bitLength : 0;
+    }
+    if(((integer && element.encoding == MessageElement::NumericEncodingType::NE_BINARY) || extended) && width > 64){
+        std::string err_message = "Element <" + paths[field.path].pointer + "> is wider than 64 bits: " + std::to_string(width) + " bit(s)" +
+                                  (extended ? " with <" + paths[field.reference].pointer + ">" : "");
+        Logger::getInstance().log(err_message, Logger::Level::ERROR);
+        throw std::invalid_argument(err_message);
+    }
+    emit(field);
+
+    if(element.routeCount == 0){
+        return;
+    }
+    routingTables.emplace_back();
+    uint32_t index = static_cast<uint32_t>(routingTables.size() - 1);
+    std::vector<std::pair<int, uint32_t>> targets;
+    Instruction branch(Instruction::OpCode::OP_ROUTE);
+    branch.table = index;
+    branch.path = field.path;
+    uint32_t route = emit(branch);
+    std::vector<uint32_t> exits;
+    for(uint32_t i = element.firstRoute; i < element.firstRoute + element.routeCount; i++){
+        targets.emplace_back(table.routes[i].key, static_cast<uint32_t>(code.size()));
+        compileElement(table, table.fields[table.routes[i].field], true);
+        exits.push_back(emit(Instruction(Instruction::OpCode::OP_JUMP)));
+    }
+    routingTables[index] = RoutingTable(targets);
+    uint32_t continuation = static_cast<uint32_t>(code.size());
+    code[route].jump = continuation;
+    for(auto exit : exits){
+        code[exit].jump = continuation;
+    }
+}
+
+// Largest number of times each path can be written running the code in
+// [from, to): alternatives of a routing are exclusive
+std::vector<uint32_t> SchemaProgram::countWrites(uint32_t from, uint32_t to) const {
+    std::vector<uint32_t> writes(paths.size(), 0);
+    uint32_t pc = from;
+    while(pc < to){
+        const Instruction& instruction = code[pc];
+        if(instruction.op == Instruction::OpCode::OP_FIELD){
+            writes[instruction.path]++;
+        } else if(instruction.op == Instruction::OpCode::OP_ROUTE){
+            std::vector<uint32_t> starts;
+            for(const auto& [key, target] : routingTables[instruction.table].entries()){
+                starts.push_back(target);
+            }
+            std::sort(starts.begin(), starts.end());
+            std::vector<uint32_t> routed(paths.size(), 0);
+            for(size_t i = 0; i < starts.size(); i++){
+                auto alternative = countWrites(starts[i], i + 1 < starts.size() ? starts[i + 1] : instruction.jump);
+                for(size_t path = 0; path < paths.size(); path++){
+                    routed[path] = std::max(routed[path], alternative[path]);
+                }
+            }
+            for(size_t path = 0; path < paths.size(); path++){
+                writes[path] += routed[path];
+            }
+            pc = instruction.jump;
+            continue;
+        }
+        pc++;
+    }
+    return writes;
+}
+
+// Only the fields read again after being decoded keep their value: those
+// referenced by repetitions, extend or existing conditions, and those
+// written more than once (whose output must be overwritten). Each of them
+// gets a register, nothing is retained for the others.
+void SchemaProgram::allocateRegisters(){
+    std::vector<uint32_t> uses(paths.size(), 0);
+    std::vector<uint32_t> writes = countWrites(0, static_cast<uint32_t>(code.size()));
+    for(const auto& instruction : code){
+        if(instruction.op == Instruction::OpCode::OP_EXTEND ||
+                  (instruction.op == Instruction::OpCode::OP_LOOP && instruction.repetitions == 0)){
+            uses[instruction.reference]++;
+        }
+    }
+    for(const auto& set : conditions){
+        for(const auto& condition : set){
+            uses[condition.path]++;
+        }
+    }
+
+    std::vector<uint32_t> registers(paths.size(), Instruction::noRegister);
+    for(size_t path = 0; path < paths.size(); path++){
+        if(uses[path] || writes[path] > 1){
+            registers[path] = registerCount++;
+        }
+    }
+    for(auto& instruction : code){
+        if(instruction.op == Instruction::OpCode::OP_FIELD){
+            instruction.reg = registers[instruction.path];
+        } else if(instruction.op == Instruction::OpCode::OP_EXTEND ||
+                  (instruction.op == Instruction::OpCode::OP_LOOP && instruction.repetitions == 0)){
+            instruction.reg = registers[instruction.reference];
+        }
+    }
+    for(auto& set : conditions){
+        for(auto& condition : set){
+            condition.reg = registers[condition.path];
+        }
+    }
+}
+
+// Instructions where the program can continue other than from the one before
+std::vector<bool> SchemaProgram::jumpTargets() const {
+    std::vector<bool> target(code.size() + 1, false);
+    for(const auto& instruction : code){
+        switch(instruction.op){
+            case Instruction::OpCode::OP_NEXT:
+                target[instruction.jump + 1] = true;
+                break;
+            case Instruction::OpCode::OP_ROUTE:
+            case Instruction::OpCode::OP_LOOP:
+            case Instruction::OpCode::OP_CONDITION:
+            case Instruction::OpCode::OP_BLOCK:
+            case Instruction::OpCode::OP_JUMP:
+                target[instruction.jump] = true;
+                break;
+            default:
+                break;
+        }
+    }
+    for(const auto& table : routingTables){
+        for(const auto& entry : table.entries()){
+            target[entry.second] = true;
+        }
+    }
+    return target;
+}
+
+bool SchemaProgram::fixedField(const Instruction& instruction){
+    if(instruction.op != Instruction::OpCode::OP_FIELD || instruction.delimited ||
+       instruction.bitLength == 0 || instruction.bitLength > 64 ||
+       instruction.encoding == MessageElement::NumericEncodingType::NE_BCD ||
+       instruction.encoding == MessageElement::NumericEncodingType::NE_ASCII){
+        return false;
+    }
+    switch(instruction.type){
+        case MessageElement::MessageElementType::MET_INTEGER:
+        case MessageElement::MessageElementType::MET_UNSIGNED_INTEGER:
+        case MessageElement::MessageElementType::MET_BOOLEAN:
+            return true;
+        case MessageElement::MessageElementType::MET_DECIMAL:
+            return instruction.bitLength == 32 || instruction.bitLength == 64;
+        default:
+            return false;
+    }
+}
+
+// Runs of fixed fields that the program always reads one after the other
+// (no loop, routing or condition can enter or leave them halfway) get an
+// OP_BLOCK in front of them, with the offset of each field from the start
+// of the run: the Engine checks the length once for the whole run and
+// extracts the fields independently of each other. The field giving a
+// routing key is left out, so that the routing follows a single field.
+void SchemaProgram::findFixedBlocks(){
+    std::vector<bool> target = jumpTargets();
+    auto member = [this](size_t pc){
+        return fixedField(code[pc]) && not (pc + 1 < code.size() && code[pc + 1].op == Instruction::OpCode::OP_ROUTE);
+    };
+    std::vector<Instruction> fused;
+    std::vector<uint32_t> moved(code.size() + 1);
+    size_t pc = 0;
+    while(pc < code.size()){
+        size_t end = pc;
+        while(end < code.size() && member(end) && (end == pc || not target[end])){
+            end++;
+        }
+        if(end - pc < 2){
+            moved[pc] = static_cast<uint32_t>(fused.size());
+            fused.push_back(code[pc]);
+            pc++;
+            continue;
+        }
+        FixedBlock block;
+        Instruction header(Instruction::OpCode::OP_BLOCK);
+        for(size_t i = pc; i < end; i++){
+            block.fields.push_back(static_cast<uint32_t>(fused.size() + 1 + i - pc));
+            block.offsets.push_back(header.bitLength);
+            block.bitLengths.push_back(code[i].bitLength);
+            header.bitLength += code[i].bitLength;
+        }
+        header.table = static_cast<uint32_t>(blocks.size());
+        header.jump = static_cast<uint32_t>(end);
+        blocks.push_back(std::move(block));
+        // Jumps to the first field now reach the block
+        moved[pc] = static_cast<uint32_t>(fused.size());
+        fused.push_back(header);
+        for(size_t i = pc; i < end; i++){
+            if(i > pc){ moved[i] = static_cast<uint32_t>(fused.size()); }
+            fused.push_back(code[i]);
+        }
+        pc = end;
+    }
+    if(blocks.empty()){
+        return;
+    }
+    moved[code.size()] = static_cast<uint32_t>(fused.size());
+    for(auto& instruction : fused){
+        switch(instruction.op){
+            case Instruction::OpCode::OP_ROUTE:
+            case Instruction::OpCode::OP_LOOP:
+            case Instruction::OpCode::OP_NEXT:
+            case Instruction::OpCode::OP_CONDITION:
+            case Instruction::OpCode::OP_BLOCK:
+            case Instruction::OpCode::OP_JUMP:
+            case Instruction::OpCode::OP_SKIP:
+                instruction.jump = moved[instruction.jump];
+                break;
+            default:
+                break;
+        }
+    }
+    for(auto& table : routingTables){
+        auto entries = table.entries();
+        for(auto& entry : entries){
+            entry.second = moved[entry.second];
+        }
+        table = RoutingTable(entries);
+    }
+    code = std::move(fused);
+}
+
+// Size of every message when no field depends on the content, 0 otherwise
+size_t SchemaProgram::fixedBitLength() const {
+    size_t bits = 0;
+    for(const auto& instruction : code){
+        if(instruction.op == Instruction::OpCode::OP_END){
+            return bits;
+        }
+        if(instruction.op == Instruction::OpCode::OP_BLOCK){
+            continue;
+        }
+        if((instruction.op != Instruction::OpCode::OP_FIELD && instruction.op != Instruction::OpCode::OP_EXTEND) ||
+           instruction.bitLength == 0){
+            return 0;
+        }
+        bits += instruction.bitLength;
+    }
+    return bits;
+}
+
+// Bit position and size of the field at 'pointer', provided that all the
+// fields before it have a fixed size
+bool SchemaProgram::fixedPosition(const std::string& pointer, size_t& offset, uint32_t& bitLength) const {
+    offset = 0;
+    for(const auto& instruction : code){
+        if(instruction.op == Instruction::OpCode::OP_FIELD && paths[instruction.path].pointer == pointer){
+            bitLength = instruction.bitLength;
+            return bitLength != 0;
+        }
+        if(instruction.op == Instruction::OpCode::OP_BLOCK){
+            continue;
+        }
+        if((instruction.op != Instruction::OpCode::OP_FIELD && instruction.op != Instruction::OpCode::OP_EXTEND) ||
+           instruction.bitLength == 0){
+            return false;
+        }
+        offset += instruction.bitLength;
+    }
+    return false;
+}
+
+// Copy of the program writing to the output only the fields at 'pointers'
+// or below them ("/MTI" selects all of its members, array indices are
+// written '*'). The other fields are read only when their value is needed
+// later (routing key, repetitions, condition, extended field) or they are
+// in 'needed', otherwise they are just skipped.
+std::shared_ptr<const SchemaProgram> SchemaProgram::project(const std::vector<std::string>& pointers,
+                                                            const std::vector<std::string>& needed) const {
+    auto below = [](const std::string& pointer, const std::string& prefix){
+        return prefix.empty() || prefix == "/" ||
+               (pointer.compare(0, prefix.size(), prefix) == 0 &&
+                (pointer.size() == prefix.size() || pointer[prefix.size()] == '/'));
+    };
+    auto selected = [&](const std::string& pointer){
+        return std::any_of(pointers.begin(), pointers.end(),
+                           [&](const std::string& prefix){ return below(pointer, prefix); });
+    };
+    for(const auto& prefix : pointers){
+        if(std::none_of(paths.begin(), paths.end(),
+                        [&](const FieldPath& path){ return below(path.pointer, prefix); })){
+            throw std::invalid_argument("Projection <" + prefix + "> does not match any field of the schema");
+        }
+    }
+
+    auto projected = std::make_shared<SchemaProgram>(*this);
+    for(size_t pc = 0; pc < projected->code.size(); pc++){
+        Instruction& instruction = projected->code[pc];
+        if(instruction.op == Instruction::OpCode::OP_FIELD){
+            instruction.visible = instruction.visible && selected(paths[instruction.path].pointer);
+            bool routing = pc + 1 < code.size() && code[pc + 1].op == Instruction::OpCode::OP_ROUTE;
+            bool kept = std::find(needed.begin(), needed.end(), paths[instruction.path].pointer) != needed.end();
+            if(not instruction.visible && instruction.reg == Instruction::noRegister && not routing && not kept){
+                instruction.op = Instruction::OpCode::OP_SKIP;
+                instruction.jump = static_cast<uint32_t>(pc + 1);
+            }
+        } else if(instruction.op == Instruction::OpCode::OP_EXTEND){
+            instruction.visible = instruction.visible && selected(paths[instruction.reference].pointer);
+        }
+    }
+
+    // Blocks read only the fields left
+    for(auto& block : projected->blocks){
+        FixedBlock kept;
+        for(size_t i = 0; i < block.fields.size(); i++){
+            if(projected->code[block.fields[i]].op == Instruction::OpCode::OP_FIELD){
+                kept.fields.push_back(block.fields[i]);
+                kept.offsets.push_back(block.offsets[i]);
+                kept.bitLengths.push_back(block.bitLengths[i]);
+            }
+        }
+        block = std::move(kept);
+    }
+
+    // Consecutive fixed length skips become a single move of the offset,
+    // unless the program can continue from the middle of them
+    std::vector<bool> target = jumpTargets();
+    auto fixedSkip = [&projected](size_t pc){
+        return projected->code[pc].op == Instruction::OpCode::OP_SKIP && projected->code[pc].bitLength != 0;
+    };
+    for(size_t pc = 0; pc < projected->code.size(); pc++){
+        Instruction& instruction = projected->code[pc];
+        if(not fixedSkip(pc)){
+            continue;
+        }
+        size_t end = pc + 1;
+        while(fixedSkip(end) && not target[end]){
+            instruction.bitLength += projected->code[end].bitLength;
+            end++;
+        }
+        instruction.jump = static_cast<uint32_t>(end);
+        pc = end - 1;
+    }
+    return projected;
+}
+
+std::string SchemaProgram::toString() const {
+    static const char* names[] = {"FIELD", "EXTEND", "SKIP", "ROUTE", "LOOP", "NEXT", "CONDITION", "BLOCK", "JUMP", "END"};
+    auto pointer = [this](uint32_t path){ return paths[path].pointer; };
+    std::ostringstream oss;
+    for(size_t pc = 0; pc < code.size(); pc++){
+        const Instruction& instruction = code[pc];
+        oss << pc << ": " << names[static_cast<int>(instruction.op)];
+        switch(instruction.op){
+            case Instruction::OpCode::OP_FIELD:
+            case Instruction::OpCode::OP_EXTEND:
+            case Instruction::OpCode::OP_SKIP:
+                oss << " " << pointer(instruction.path) << " " << MessageElement::MessageElementTypeToString(instruction.type)
+                    << " " << instruction.bitLength << " bit(s)";
+                if(instruction.delimited){ oss << " delimiter " << instruction.delimiter; }
+                if(instruction.op == Instruction::OpCode::OP_EXTEND){ oss << " extends " << pointer(instruction.reference); }
+                if(instruction.reg != Instruction::noRegister){ oss << " r" << instruction.reg; }
+                if(instruction.op == Instruction::OpCode::OP_SKIP && instruction.jump != pc + 1){ oss << " then " << instruction.jump; }
+                break;
+            case Instruction::OpCode::OP_ROUTE:
+                oss << " " << routingTables[instruction.table].toString() << " then " << instruction.jump;
+                break;
+            case Instruction::OpCode::OP_LOOP:
+                oss << " " << pointer(instruction.path);
+                if(instruction.repetitions == 0){ oss << " " << pointer(instruction.reference) << " r" << instruction.reg; }
+                else { oss << " " << instruction.repetitions; }
+                oss << " exit " << instruction.jump;
+                break;
+            case Instruction::OpCode::OP_CONDITION:
+                oss << " set " << instruction.table << " else " << instruction.jump;
+                break;
+            case Instruction::OpCode::OP_BLOCK:
+                oss << " " << instruction.bitLength << " bit(s) then " << instruction.jump;
+                break;
+            case Instruction::OpCode::OP_NEXT:
+            case Instruction::OpCode::OP_JUMP:
+                oss << " " << instruction.jump;
+                break;
+            default:
+                break;
+        }
+        oss << std::endl;
+    }
+    return oss.str();
+}
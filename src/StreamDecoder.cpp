@@ -0,0 +1,106 @@
+#include "StreamDecoder.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+StreamDecoder::Source StreamDecoder::fromDescriptor(int fd){
+    return [fd](unsigned char* data, size_t size) -> size_t {
+        while(true){
+            ssize_t count = ::read(fd, data, size);
+            if(count >= 0){
+                return static_cast<size_t>(count);
+            }
+            if(errno != EINTR){
+                throw std::runtime_error("Unable to read the stream: " + std::string(std::strerror(errno)));
+            }
+        }
+    };
+}
+
+StreamDecoder::Source StreamDecoder::fromStream(std::istream& stream){
+    return [&stream](unsigned char* data, size_t size) -> size_t {
+        stream.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(size));
+        return static_cast<size_t>(stream.gcount());
+    };
+}
+
+StreamDecoder::StreamDecoder(const Schema& schema, Source source_, size_t capacity) :
+    schemaName(schema.catalogName), framing(schema.framing), source(std::move(source_)), buffer(capacity) {
+    if(framing.type == Framing::Type::NONE){
+        throw std::invalid_argument("Schema <" + schemaName + "> does not define how its messages are framed in a stream");
+    }
+    if(framing.type == Framing::Type::FIXED && framing.byteLength > capacity){
+        throw std::invalid_argument("Messages of schema <" + schemaName + "> are larger than the stream buffer of " +
+                                    std::to_string(capacity) + " bytes");
+    }
+}
+
+bool StreamDecoder::next(BitView& message){
+    while(not frame(message)){
+        if(not fill()){
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t StreamDecoder::nextBatch(std::vector<BitView>& batch, size_t maxMessages){
+    batch.clear();
+    BitView message;
+    // Refilling moves the buffer: only when no view has been handed out yet
+    if(maxMessages == 0 || not next(message)){
+        return 0;
+    }
+    batch.push_back(message);
+    while(batch.size() < maxMessages && frame(message)){
+        batch.push_back(message);
+    }
+    return batch.size();
+}
+
+// Next complete message already in the buffer
+bool StreamDecoder::frame(BitView& message){
+    if(begin == end){
+        return false;
+    }
+    size_t length = framing.frameLength(buffer.data() + begin, end - begin, scanned);
+    if(length == Framing::incomplete){
+        return false;
+    }
+    message = BitView(buffer.data() + begin, 0, length * 8, length);
+    begin += length;
+    scanned = 0;
+    messages++;
+    return true;
+}
+
+// Move the partial message at the end of the buffer to its start and read
+// after it; false at the end of the stream
+bool StreamDecoder::fill(){
+    if(finished){
+        return false;
+    }
+    if(begin > 0){
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+    if(end == buffer.size()){
+        throw std::length_error("Message of schema <" + schemaName + "> larger than the stream buffer of " +
+                                std::to_string(buffer.size()) + " bytes");
+    }
+    size_t count = source(buffer.data() + end, buffer.size() - end);
+    if(count == 0){
+        finished = true;
+        if(end > begin){
+            Logger::getInstance().log("Incomplete message of " + std::to_string(end - begin) + " byte(s) at the end of the stream of schema <" +
+                                      schemaName + ">: discarded", Logger::Level::WARNING);
+            begin = end;
+        }
+        return false;
+    }
+    end += count;
+    return true;
+}
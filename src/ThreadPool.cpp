@@ -0,0 +1,182 @@
+#include "ThreadPool.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+    // Pool and worker the current thread belongs to, if any
+    thread_local const ThreadPool* currentPool = nullptr;
+    thread_local size_t currentWorker = 0;
+}
+
+ThreadPool::ThreadPool(size_t threads, bool pinned){
+    if(threads == 0){
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for(size_t i = 0; i < threads; i++){
+        workers.push_back(std::make_unique<Worker>());
+    }
+    // Started once all the deques exist, as a worker may steal right away
+    for(size_t i = 0; i < threads; i++){
+        workers[i]->thread = std::thread(&ThreadPool::run, this, i, pinned);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto& worker : workers){
+        worker->thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task){
+    size_t index = current();
+    if(index == workers.size()){
+        index = next++ % workers.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    pending++;
+    {
+        // Taken so that a worker about to sleep does not miss the task
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body){
+    if(count == 0){
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if(chunks == 1){
+        body(0, count);
+        return;
+    }
+
+    struct State {
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    state->remaining = chunks;
+    auto runChunk = [state, &body, grain, count](size_t chunk){
+        try{
+            size_t begin = chunk * grain;
+            body(begin, std::min(begin + grain, count));
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if(not state->error){
+                state->error = std::current_exception();
+            }
+        }
+        if(--state->remaining == 0){
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->done.notify_all();
+        }
+    };
+    // The first chunk is kept for the calling thread
+    for(size_t chunk = 1; chunk < chunks; chunk++){
+        submit([runChunk, chunk]{ runChunk(chunk); });
+    }
+    runChunk(0);
+
+    // Help with the queued tasks (ours or not) instead of just waiting
+    size_t index = current();
+    while(state->remaining > 0){
+        if(runOne(index)){
+            continue;
+        }
+        // Nothing left to run: the remaining chunks are running elsewhere
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&]{ return state->remaining == 0; });
+    }
+    if(state->error){
+        std::rethrow_exception(state->error);
+    }
+}
+
+void ThreadPool::run(size_t index, bool pinned){
+    currentPool = this;
+    currentWorker = index;
+#ifdef __linux__
+    if(pinned){
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0){
+            Logger::getInstance().log("Unable to pin the worker thread " + std::to_string(index), Logger::Level::WARNING);
+        }
+    }
+#else
+    if(pinned){
+        Logger::getInstance().log("Pinning of the worker threads is not supported on this platform", Logger::Level::WARNING);
+    }
+#endif
+    while(true){
+        if(runOne(index)){
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]{ return stopping || pending > 0; });
+        if(stopping && pending == 0){
+            return;
+        }
+    }
+}
+
+// Run a single task: the newest of the deque 'index', otherwise the oldest
+// of another deque. 'index' is size() for a thread outside the pool.
+bool ThreadPool::runOne(size_t index){
+    std::function<void()> task;
+    bool found = index < workers.size() && take(index, true, task);
+    for(size_t i = 1; not found && i <= workers.size(); i++){
+        found = take((index + i) % workers.size(), false, task);
+    }
+    if(not found){
+        return false;
+    }
+    try{
+        task();
+    } catch (const std::exception& e) {
+        Logger::getInstance().log("Task failed in the thread pool: " + std::string(e.what()), Logger::Level::ERROR);
+    }
+    return true;
+}
+
+bool ThreadPool::take(size_t index, bool newest, std::function<void()>& task){
+    Worker& worker = *workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if(worker.tasks.empty()){
+        return false;
+    }
+    if(newest){
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+    } else {
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+    }
+    pending--;
+    return true;
+}
+
+// Worker of the calling thread, size() if it is not one of ours
+size_t ThreadPool::current() const {
+    return currentPool == this ? currentWorker : workers.size();
+}
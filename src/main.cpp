@@ -1,10 +1,17 @@
 #include "Engine.h"
 #include "Logger.h"
 #include "FileWatcher.h"
+#include "StreamDecoder.h"
+#include "MessageFilter.h"
+#include "ColumnarSink.h"
 #include <chrono>
+#include <fstream>
 #include <thread>
 #include <iostream>
+#include <charconv>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <unistd.h>
 
 #include <grpcpp/grpcpp.h>
@@ -13,28 +20,260 @@
 using grpc::Server;
 using grpc::ServerBuilder;
 using grpc::ServerContext;
+using grpc::ServerReaderWriter;
 using grpc::Status;
 using interface::toJsonRequest;
 using interface::toJsonResponse;
 using interface::toBitsRequest;
 using interface::toBitsResponse;
+using interface::toJsonBatchRequest;
+using interface::toJsonBatchResponse;
 using interface::service;
+using interface::Format;
+
+// Projection of the schema of 'type' to the fields of a request, none if the
+// request wants all of them; the fields of 'filter' are decoded all the same
+template<typename Fields>
+std::shared_ptr<const SchemaProgram> FieldMask(const std::string& type, const Fields& fields, const MessageFilter* filter = nullptr) {
+  if(fields.empty()){
+    return nullptr;
+  }
+  return SchemaCatalog::getInstance().getProjection(type, std::vector<std::string>(fields.begin(), fields.end()),
+                                                    filter != nullptr ? filter->pointers() : std::vector<std::string>());
+}
+
+// Filter of a request on the messages of 'type', none without expressions
+template<typename Expressions>
+std::shared_ptr<const MessageFilter> Filter(const std::string& type, const Expressions& expressions) {
+  if(expressions.empty()){
+    return nullptr;
+  }
+  const Schema* schema = SchemaCatalog::getInstance().getSchema(type);
+  if(schema == nullptr){
+    throw std::invalid_argument("Unknown type <" + type + ">");
+  }
+  return MessageFilter::compile(*schema->program, std::vector<std::string>(expressions.begin(), expressions.end()));
+}
+
+// Engine format of the output requested as 'format': a google.protobuf.Value
+// is built from CBOR
+DataFormat EngineFormat(Format format) {
+  switch(format){
+    case interface::CBOR:
+    case interface::STRUCT:
+      return DataFormat::CBOR;
+    case interface::MSGPACK:
+      return DataFormat::MSGPACK;
+    default:
+      return DataFormat::JSON;
+  }
+}
+
+// SAX handler building a google.protobuf.Value out of the events of
+// nlohmann::json::sax_parse(), without an intermediate document
+class ValueBuilder {
+public:
+  explicit ValueBuilder(google::protobuf::Value& root_) : root(root_) {}
+
+  bool null() { next()->set_null_value(google::protobuf::NULL_VALUE); return true; }
+  bool boolean(bool value) { next()->set_bool_value(value); return true; }
+  bool number_integer(json::number_integer_t value) {
+    if(value < -exactIntegers || value > exactIntegers){
+      next()->set_string_value(std::to_string(value));
+    } else {
+      next()->set_number_value(static_cast<double>(value));
+    }
+    return true;
+  }
+  bool number_unsigned(json::number_unsigned_t value) {
+    if(value > static_cast<uint64_t>(exactIntegers)){
+      next()->set_string_value(std::to_string(value));
+    } else {
+      next()->set_number_value(static_cast<double>(value));
+    }
+    return true;
+  }
+  bool number_float(json::number_float_t value, const json::string_t&) { next()->set_number_value(value); return true; }
+  bool string(json::string_t& value) { next()->set_string_value(std::move(value)); return true; }
+  bool binary(json::binary_t&) { return false; }
+  bool key(json::string_t& name) { pendingKey = std::move(name); return true; }
+  bool start_object(std::size_t) {
+    google::protobuf::Value* value = next();
+    value->mutable_struct_value();
+    open.push_back(value);
+    return true;
+  }
+  bool start_array(std::size_t) {
+    google::protobuf::Value* value = next();
+    value->mutable_list_value();
+    open.push_back(value);
+    return true;
+  }
+  bool end_object() { open.pop_back(); return true; }
+  bool end_array() { open.pop_back(); return true; }
+  bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) {
+    throw std::invalid_argument(e.what());
+  }
+
+private:
+  // Integers a double holds exactly; the larger ones are written as strings
+  static constexpr int64_t exactIntegers = int64_t(1) << 53;
+
+  google::protobuf::Value& root;
+  std::vector<google::protobuf::Value*> open;   // containers being filled
+  std::string pendingKey;
+
+  // Slot of the next value
+  google::protobuf::Value* next() {
+    if(open.empty()){
+      return &root;
+    }
+    google::protobuf::Value* container = open.back();
+    if(container->has_list_value()){
+      return container->mutable_list_value()->add_values();
+    }
+    return &(*container->mutable_struct_value()->mutable_fields())[pendingKey];
+  }
+};
+
+void CborToValue(std::string_view cbor, google::protobuf::Value& value) {
+  ValueBuilder builder(value);
+  json::sax_parse(cbor.begin(), cbor.end(), &builder, nlohmann::detail::input_format_t::cbor);
+}
+
+// Document of a google.protobuf.Value to encode. A Value only has doubles
+// and strings, so each number is converted by the type of its field in the
+// schema: integers from whole numbers, or from strings of digits for the
+// ones a double cannot hold, and decimals as they are.
+class ValueReader {
+public:
+  explicit ValueReader(const Schema* schema) {
+    if(schema == nullptr){
+      return;
+    }
+    const SchemaProgram& program = *schema->program;
+    for(const Instruction& instruction : program.code){
+      if(instruction.op == Instruction::OpCode::OP_FIELD || instruction.op == Instruction::OpCode::OP_SKIP){
+        types.emplace(program.paths[instruction.path].pointer, instruction.type);
+      }
+    }
+  }
+
+  json read(const google::protobuf::Value& value) {
+    switch(value.kind_case()){
+      case google::protobuf::Value::kBoolValue:
+        return value.bool_value();
+      case google::protobuf::Value::kNumberValue:
+        {
+          double number = value.number_value();
+          if(type() == MessageElement::MessageElementType::MET_DECIMAL || std::trunc(number) != number){
+            return number;
+          } else if(number >= 0 && number < 18446744073709551616.0){
+            return static_cast<uint64_t>(number);
+          } else if(number < 0 && number >= -9223372036854775808.0){
+            return static_cast<int64_t>(number);
+          }
+          return number;
+        }
+      case google::protobuf::Value::kStringValue:
+        {
+          const std::string& text = value.string_value();
+          MessageElement::MessageElementType field = type();
+          if(field == MessageElement::MessageElementType::MET_INTEGER || field == MessageElement::MessageElementType::MET_UNSIGNED_INTEGER){
+            const char* end = text.data() + text.size();
+            uint64_t unsignedValue;
+            int64_t signedValue;
+            if(not text.empty() && text[0] != '-' && std::from_chars(text.data(), end, unsignedValue).ptr == end){
+              return unsignedValue;
+            } else if(not text.empty() && std::from_chars(text.data(), end, signedValue).ptr == end){
+              return signedValue;
+            }
+          }
+          return text;
+        }
+      case google::protobuf::Value::kStructValue:
+        {
+          json object = json::object();
+          size_t base = pointer.size();
+          for(const auto& field : value.struct_value().fields()){
+            pointer += '/';
+            pointer += field.first;
+            object[field.first] = read(field.second);
+            pointer.resize(base);
+          }
+          return object;
+        }
+      case google::protobuf::Value::kListValue:
+        {
+          json array = json::array();
+          pointer += "/*";
+          for(const auto& item : value.list_value().values()){
+            array.push_back(read(item));
+          }
+          pointer.resize(pointer.size() - 2);
+          return array;
+        }
+      default:
+        return nullptr;
+    }
+  }
+
+private:
+  std::unordered_map<std::string, MessageElement::MessageElementType> types;    // by pointer, '*' in place of the indices
+  std::string pointer;
+
+  MessageElement::MessageElementType type() const {
+    auto it = types.find(pointer);
+    return it != types.end() ? it->second : MessageElement::MessageElementType::MET_UNDEFINED;
+  }
+};
 
 class ServiceImpl final : public service::Service {
+public:
+  explicit ServiceImpl(ThreadPool& pool_) : pool(pool_) {}
+
+private:
+  ThreadPool& pool;
+
   Status toJson(ServerContext* context, const toJsonRequest* request, toJsonResponse* response) override {
-    std::string inputMessageBase64 = request->message_base64();
+    const std::string& inputMessageBase64 = request->message_base64();
+    const std::string& inputMessageBytes = request->message_bytes();
     std::string inputType = request->message_type();
 
-    Logger::getInstance().log("Input message (type: <" + inputType + ">): "+inputMessageBase64, Logger::Level::INFO);
+    if(inputMessageBytes.empty()){
+        Logger::getInstance().log("Input message (type: <" + inputType + ">): "+inputMessageBase64, Logger::Level::INFO);
+    } else {
+        Logger::getInstance().log("Input message (type: <" + inputType + ">): " + std::to_string(inputMessageBytes.size()) + " raw byte(s)", Logger::Level::INFO);
+    }
  
     std::string returnJson;
     try{
-        Engine engine;
+        Engine& engine = Engine::local();
         auto start_time = std::chrono::high_resolution_clock::now();
-        returnJson = engine.convertToJson(inputMessageBase64, inputType, SchemaCatalog::getInstance().getSchema(inputType));
+        if(request->output_format() == interface::COLUMNS){
+            throw std::invalid_argument("Columnar output is only available for batches");
+        }
+        std::shared_ptr<const SchemaProgram> projection = FieldMask(inputType, request->fields());
+        DecodeOptions options{projection.get(), nullptr, EngineFormat(request->output_format())};
+        if(inputMessageBytes.empty()){
+            returnJson = engine.convertToJson(inputMessageBase64, inputType, SchemaCatalog::getInstance().getSchema(inputType), options);
+        } else {
+            // The engine reads the request buffer in place
+            size_t bitLength = request->message_bit_length() ? request->message_bit_length() : inputMessageBytes.size() * 8;
+            if(bitLength > inputMessageBytes.size() * 8){
+                throw std::invalid_argument("Provided bit length <" + std::to_string(bitLength) + "> exceeds the size of the payload");
+            }
+            returnJson = engine.convertToJson(reinterpret_cast<const unsigned char*>(inputMessageBytes.data()), bitLength,
+                                              inputType, SchemaCatalog::getInstance().getSchema(inputType), options);
+        }
+        if(request->output_format() == interface::STRUCT){
+            CborToValue(returnJson, *response->mutable_message_value());
+        }
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
-        Logger::getInstance().log("Json: " + returnJson, Logger::Level::DEBUG);
+        if(options.format == DataFormat::JSON){
+            Logger::getInstance().log("Json: " + returnJson, Logger::Level::DEBUG);
+        }
         Logger::getInstance().log("Elaboration time: " + std::to_string(duration.count()) + " us", Logger::Level::INFO);
     } catch (const std::exception& e) {
         Logger::getInstance().log("Engine exception: " + std::string(e.what()), Logger::Level::ERROR);
@@ -45,7 +284,11 @@ class ServiceImpl final : public service::Service {
         grpc::Status(grpc::StatusCode::INTERNAL, std::string(e.what()));
     }
 
-    response->set_message_json(returnJson);
+    if(request->output_format() == interface::JSON){
+        response->set_message_json(returnJson);
+    } else if(request->output_format() != interface::STRUCT){
+        response->set_message_binary(returnJson);
+    }
     response->set_message_type(inputType);
     response->set_response_status(200);
     response->set_response_message("OK");
@@ -54,19 +297,39 @@ class ServiceImpl final : public service::Service {
   }
 
   Status toBits(ServerContext* context, const toBitsRequest* request, toBitsResponse* response) override {
-    std::string inputMessageJson = request->message_json();
+    const std::string& inputMessageJson = request->message_json();
     std::string inputType = request->message_type();
 
-    Logger::getInstance().log("Input message (type: <" + inputType + ">): "+inputMessageJson, Logger::Level::INFO);
+    Format inputFormat = request->input_format();
+
+    if(inputFormat == interface::JSON){
+        Logger::getInstance().log("Input message (type: <" + inputType + ">): "+inputMessageJson, Logger::Level::INFO);
+    } else if(inputFormat == interface::STRUCT){
+        Logger::getInstance().log("Input message (type: <" + inputType + ">): protobuf value", Logger::Level::INFO);
+    } else {
+        Logger::getInstance().log("Input message (type: <" + inputType + ">): " + std::to_string(request->message_binary().size()) + " byte(s) of " + Format_Name(inputFormat), Logger::Level::INFO);
+    }
  
     std::pair<std::string, unsigned int> returnBase64;
     try{
-        Engine engine;
+        Engine& engine = Engine::local();
         auto start_time = std::chrono::high_resolution_clock::now();
-        returnBase64 = engine.convertToBinary(inputMessageJson, SchemaCatalog::getInstance().getSchema(inputType));
+        const Schema* schema = SchemaCatalog::getInstance().getSchema(inputType);
+        if(inputFormat == interface::STRUCT){
+            json document = ValueReader(schema).read(request->message_value());
+            returnBase64 = request->raw_output() ? engine.convertToBytes(document, schema) : engine.convertToBinary(document, schema);
+        } else if(inputFormat != interface::JSON){
+            const std::string& document = request->message_binary();
+            returnBase64 = request->raw_output() ? engine.convertToBytes(document, schema, EngineFormat(inputFormat))
+                                                 : engine.convertToBinary(document, schema, EngineFormat(inputFormat));
+        } else if(request->raw_output()){
+            returnBase64 = engine.convertToBytes(inputMessageJson, schema);
+        } else {
+            returnBase64 = engine.convertToBinary(inputMessageJson, schema);
+            Logger::getInstance().log("Bit stream base64: " + returnBase64.first + " (" + std::to_string(returnBase64.second) + " bits)", Logger::Level::DEBUG);
+        }
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
-        Logger::getInstance().log("Bit stream base64: " + returnBase64.first + " (" + std::to_string(returnBase64.second) + " bits)", Logger::Level::DEBUG);
         Logger::getInstance().log("Elaboration time: " + std::to_string(duration.count()) + " us", Logger::Level::INFO);
     } catch (const std::exception& e) {
         Logger::getInstance().log("Engine exception: " + std::string(e.what()), Logger::Level::ERROR);
@@ -78,8 +341,12 @@ class ServiceImpl final : public service::Service {
         grpc::Status(grpc::StatusCode::INTERNAL, std::string(e.what()));
     }
 
-    response->set_message_base64(returnBase64.first);
     response->set_message_length(static_cast<int>(returnBase64.second));
+    if(request->raw_output()){
+        response->set_message_bytes(std::move(returnBase64.first));
+    } else {
+        response->set_message_base64(std::move(returnBase64.first));
+    }
     response->set_message_type(inputType);
     response->set_response_status(200);
     response->set_response_message("OK");
@@ -87,11 +354,267 @@ class ServiceImpl final : public service::Service {
     return Status::OK;
   }
 
+  Status toJsonBatch(ServerContext* context, const toJsonBatchRequest* request, toJsonBatchResponse* response) override {
+    return decodeBatch(*request, response);
+  }
+
+  Status toJsonBatchStream(ServerContext* context, ServerReaderWriter<toJsonBatchResponse, toJsonBatchRequest>* stream) override {
+    toJsonBatchRequest request;
+    while(stream->Read(&request)){
+        toJsonBatchResponse response;
+        Status status = decodeBatch(request, &response);
+        if(not status.ok()){
+            return status;
+        }
+        stream->Write(response);
+    }
+    return Status::OK;
+  }
+
+  // Decode the messages of a batch in parallel on the pool
+  Status decodeBatch(const toJsonBatchRequest& request, toJsonBatchResponse* response) {
+    std::string inputType = request.message_type();
+    Logger::getInstance().log("Input batch (type: <" + inputType + ">): " + std::to_string(request.messages_size()) + " message(s)", Logger::Level::INFO);
+
+    response->set_message_type(inputType);
+    try{
+        auto start_time = std::chrono::high_resolution_clock::now();
+        // The engines read the request buffers in place
+        std::vector<BitView> messages;
+        messages.reserve(request.messages_size());
+        for(int i = 0; i < request.messages_size(); i++){
+            const std::string& bytes = request.messages(i);
+            size_t bitLength = i < request.message_bit_lengths_size() && request.message_bit_lengths(i) ? request.message_bit_lengths(i) : bytes.size() * 8;
+            if(bitLength > bytes.size() * 8){
+                throw std::invalid_argument("Provided bit length <" + std::to_string(bitLength) + "> of message " + std::to_string(i) + " exceeds the size of its payload");
+            }
+            messages.emplace_back(reinterpret_cast<const unsigned char*>(bytes.data()), 0, bitLength, bytes.size());
+        }
+        std::shared_ptr<const MessageFilter> filter = Filter(inputType, request.filters());
+        std::shared_ptr<const SchemaProgram> projection = FieldMask(inputType, request.fields(), filter.get());
+        Format outputFormat = request.output_format();
+        DecodeOptions options{projection.get(), filter.get(), EngineFormat(outputFormat)};
+        if(outputFormat == interface::COLUMNS){
+            ColumnarSink table;
+            Engine::convertToColumns(pool, messages, SchemaCatalog::getInstance().getSchema(inputType), table, options);
+            for(size_t i = 0; i < table.size(); i++){
+                response->add_response_status(table.ok(i) ? 200 : table.filtered(i) ? 204 : 500);
+                response->add_response_message(table.ok(i) ? std::string("OK") : table.filtered(i) ? std::string("Filtered out") : table.error(i));
+            }
+            std::ostringstream columns;
+            table.writeTo(columns, inputType);
+            response->set_columns(columns.str());
+            response->set_filtered(static_cast<uint32_t>(table.filtered()));
+            return Status::OK;
+        }
+        OutputSink sink;
+        Engine::convertToJsonBatch(pool, messages, SchemaCatalog::getInstance().getSchema(inputType), sink, options);
+        // One output per message in the field of the format, empty for the failed ones
+        auto addOutput = [response, outputFormat](std::string_view output){
+            if(outputFormat == interface::JSON){
+                response->add_message_json(std::string(output));
+            } else if(outputFormat == interface::STRUCT){
+                google::protobuf::Value* value = response->add_message_value();
+                if(not output.empty()){ CborToValue(output, *value); }
+            } else {
+                response->add_message_binary(std::string(output));
+            }
+        };
+        for(size_t i = 0; i < sink.size(); i++){
+            if(sink.filtered(i)){
+                addOutput(std::string_view());
+                response->add_response_status(204);
+                response->add_response_message("Filtered out");
+                continue;
+            }
+            addOutput(sink.ok(i) ? sink.output(i) : std::string_view());
+            response->add_response_status(sink.ok(i) ? 200 : 500);
+            response->add_response_message(sink.ok(i) ? std::string("OK") : std::string(sink.output(i)));
+        }
+        response->set_filtered(static_cast<uint32_t>(sink.filtered()));
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+        Logger::getInstance().log("Elaboration time: " + std::to_string(duration.count()) + " us", Logger::Level::INFO);
+    } catch (const std::exception& e) {
+        Logger::getInstance().log("Engine exception: " + std::string(e.what()), Logger::Level::ERROR);
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, std::string(e.what()));
+    }
+    return Status::OK;
+  }
+
 };
 
-void RunServer(const std::string& service_port) {
+// Print the messages of 'sink' not filtered out: one json per line (empty
+// for the messages that cannot be decoded), or the sequence of the CBOR or
+// MessagePack items of the decoded ones
+void PrintMessages(const OutputSink& sink, const std::string& type, DataFormat format) {
+  for(size_t i = 0; i < sink.size(); i++){
+    if(sink.filtered(i)){
+      continue;
+    } else if(sink.ok(i)){
+      std::cout << sink.output(i);
+      if(format == DataFormat::JSON){ std::cout << '\n'; }
+    } else {
+      Logger::getInstance().log("Unable to decode a message of type <" + type + ">: " + std::string(sink.output(i)), Logger::Level::ERROR);
+      if(format == DataFormat::JSON){ std::cout << '\n'; }
+    }
+  }
+}
+
+// Print the rows of 'table' as a record batch of an Arrow IPC stream: a new
+// stream, after the end of the one open in 'streamType', starts with every
+// change of type
+void PrintColumns(const ColumnarSink& table, const std::string& type, std::string& streamType) {
+  for(size_t i = 0; i < table.size(); i++){
+    if(not table.ok(i) && not table.filtered(i)){
+      Logger::getInstance().log("Unable to decode a message of type <" + type + ">: " + table.error(i), Logger::Level::ERROR);
+    }
+  }
+  if(table.rows() == 0){
+    return;
+  }
+  if(streamType != type){
+    if(not streamType.empty()){
+      ColumnarSink::writeEnd(std::cout);
+    }
+    table.writeSchema(std::cout, type);
+    streamType = type;
+  }
+  table.writeBatch(std::cout);
+}
+
+// Decode a capture file, one <type>:<base64_payload> message per line, and
+// print them (see PrintMessages(), or PrintColumns() for a record batch of
+// each batch of messages). Consecutive messages of the same type are decoded
+// in parallel.
+int DecodeCapture(const std::string& capture_path, const std::vector<std::string>& fields,
+                  const std::vector<std::string>& filters, DataFormat format, bool columns, ThreadPool& pool) {
+  std::ifstream capture(capture_path);
+  if(not capture){
+    Logger::getInstance().log("Unable to open the capture file <" + capture_path + ">", Logger::Level::CRITICAL);
+    return 3;
+  }
+  const size_t batchSize = 1 << 16;
+  std::string line;
+  std::string batchType;
+  std::vector<unsigned char> payloads;
+  std::vector<std::pair<size_t, size_t>> ranges;    // offset and bytes of each payload
+  std::vector<BitView> messages;
+  OutputSink sink;
+  std::string streamType;
+  size_t total = 0;
+  size_t filtered = 0;
+  auto flush = [&]() {
+    if(ranges.empty()){ return; }
+    messages.clear();
+    for(const auto& range : ranges){
+      messages.emplace_back(payloads.data() + range.first, 0, range.second * 8, range.second);
+    }
+    sink.clear();
+    ColumnarSink table;
+    const Schema* schema = SchemaCatalog::getInstance().getSchema(batchType);
+    try{
+      if(schema == nullptr){
+        throw std::invalid_argument("Unknown type <" + batchType + ">");
+      }
+      std::shared_ptr<const MessageFilter> filter = Filter(batchType, filters);
+      std::shared_ptr<const SchemaProgram> projection = FieldMask(batchType, fields, filter.get());
+      DecodeOptions options{projection.get(), filter.get(), format};
+      if(columns){
+        Engine::convertToColumns(pool, messages, schema, table, options);
+      } else {
+        Engine::convertToJsonBatch(pool, messages, schema, sink, options);
+      }
+    } catch (const std::exception& e) {
+      sink.clear();
+      table = ColumnarSink();
+      for(size_t i = 0; i < messages.size(); i++){
+        sink.appendError(e.what());
+        table.appendError(e.what());
+      }
+    }
+    if(columns){
+      total += table.size();
+      filtered += table.filtered();
+      PrintColumns(table, batchType, streamType);
+    } else {
+      total += sink.size();
+      filtered += sink.filtered();
+      PrintMessages(sink, batchType, format);
+    }
+    payloads.clear();
+    ranges.clear();
+  };
+  while(std::getline(capture, line)){
+    std::size_t delimiter_pos = line.find(":");
+    std::string inputType = delimiter_pos == std::string::npos ? std::string() : line.substr(0, delimiter_pos);
+    if(inputType != batchType || ranges.size() == batchSize){
+      flush();
+      batchType = inputType;
+    }
+    size_t offset = payloads.size();
+    size_t length = delimiter_pos == std::string::npos ? 0 : line.size() - delimiter_pos - 1;
+    payloads.resize(offset + Base64::decodedLength(length));
+    size_t bytes = length ? Base64::decode(line.data() + delimiter_pos + 1, length, payloads.data() + offset) : 0;
+    payloads.resize(offset + bytes);
+    ranges.emplace_back(offset, bytes);
+  }
+  flush();
+  if(not streamType.empty()){
+    ColumnarSink::writeEnd(std::cout);
+  }
+  std::cout.flush();
+  if(not filters.empty()){
+    Logger::getInstance().log("Filtered out " + std::to_string(filtered) + " of " + std::to_string(total) + " message(s)", Logger::Level::INFO);
+  }
+  return 0;
+}
+
+// Decode the messages of type 'inputType' read back to back from the
+// standard input, printing them as for a capture file
+int DecodeStream(const std::string& inputType, const std::vector<std::string>& fields,
+                 const std::vector<std::string>& filters, DataFormat format, bool columns, ThreadPool& pool) {
+  const Schema* schema = SchemaCatalog::getInstance().getSchema(inputType);
+  if(schema == nullptr){
+    Logger::getInstance().log("Unknown type <" + inputType + "> for the input stream", Logger::Level::CRITICAL);
+    return 4;
+  }
+  std::shared_ptr<const MessageFilter> filter = Filter(inputType, filters);
+  std::shared_ptr<const SchemaProgram> projection = FieldMask(inputType, fields, filter.get());
+  StreamDecoder stream(*schema, StreamDecoder::fromDescriptor(STDIN_FILENO));
+  std::vector<BitView> messages;
+  DecodeOptions options{projection.get(), filter.get(), format};
+  OutputSink sink;
+  ColumnarSink table;
+  std::string streamType;
+  size_t filtered = 0;
+  while(stream.nextBatch(messages, 1 << 16)){
+    if(columns){
+      table.clear();
+      Engine::convertToColumns(pool, messages, schema, table, options);
+      filtered += table.filtered();
+      PrintColumns(table, inputType, streamType);
+      continue;
+    }
+    sink.clear();
+    Engine::convertToJsonBatch(pool, messages, schema, sink, options);
+    filtered += sink.filtered();
+    PrintMessages(sink, inputType, format);
+  }
+  if(not streamType.empty()){
+    ColumnarSink::writeEnd(std::cout);
+  }
+  std::cout.flush();
+  Logger::getInstance().log("Decoded " + std::to_string(stream.getMessages()) + " message(s) from the input stream", Logger::Level::INFO);
+  if(filter != nullptr){
+    Logger::getInstance().log("Filtered out " + std::to_string(filtered) + " message(s)", Logger::Level::INFO);
+  }
+  return 0;
+}
+
+void RunServer(const std::string& service_port, ThreadPool& pool) {
   std::string server_address("0.0.0.0:"+service_port);
-  ServiceImpl service;
+  ServiceImpl service(pool);
 
   ServerBuilder builder;
   builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
@@ -103,6 +626,23 @@ void RunServer(const std::string& service_port) {
   server->Wait();
 }
 
+void Usage(const char* program) {
+  std::cerr << "Usage: " << program << " -c catalog_path -l log_level -p service_port -d input_data -f capture_path -s stream_type -m field,... -w filter -o json|cbor|msgpack|columns -t threads -a" << std::endl;
+}
+
+// Number of worker threads given as 'text', exiting with the usage if it is not one
+size_t Threads(const char* program, const char* text) {
+  size_t threads = 0;
+  const char* end = text + std::strlen(text);
+  auto [ptr, ec] = std::from_chars(text, end, threads);
+  if(ptr == text || ptr != end || ec != std::errc()){
+    std::cerr << "Invalid number of threads <" << text << ">" << std::endl;
+    Usage(program);
+    std::exit(EXIT_FAILURE);
+  }
+  return threads;
+}
+
 int main(int argc, char* argv[]) {
 
     int opt;
@@ -110,8 +650,16 @@ int main(int argc, char* argv[]) {
     std::string log_level = std::getenv("LOG_LEVEL") ? std::string(std::getenv("LOG_LEVEL")) : "info";
     std::string service_port = std::getenv("PORT") ? std::string(std::getenv("PORT")) : "50051";
     std::string input_data = "";
+    std::string capture_path = "";
+    std::string stream_type = "";
+    std::vector<std::string> fields;
+    std::vector<std::string> filters;
+    DataFormat output_format = DataFormat::JSON;
+    bool output_columns = false;
+    size_t threads = std::getenv("THREADS") ? Threads(argv[0], std::getenv("THREADS")) : 0;
+    bool pinned = std::getenv("PIN_THREADS") != nullptr;
 
-    while ((opt = getopt(argc, argv, "c:l:p:d:")) != -1) {
+    while ((opt = getopt(argc, argv, "c:l:p:d:f:s:m:w:o:t:a")) != -1) {
         switch (opt) {
             case 'c':
                 catalog_path = optarg;
@@ -122,12 +670,51 @@ int main(int argc, char* argv[]) {
             case 'd':
                 input_data = optarg;
                 break;
+            case 'f':
+                capture_path = optarg;
+                break;
+            case 's':
+                stream_type = optarg;
+                break;
+            case 'm':
+                {
+                    // Comma separated JSON pointers of the fields to decode
+                    std::stringstream mask(optarg);
+                    std::string field;
+                    while(std::getline(mask, field, ',')){
+                        if(not field.empty()){ fields.push_back(field); }
+                    }
+                    break;
+                }
+            case 'w':
+                filters.push_back(optarg);
+                break;
+            case 'o':
+                {
+                    std::string format = optarg;
+                    std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+                    if(format == "cbor") output_format = DataFormat::CBOR;
+                    else if(format == "msgpack") output_format = DataFormat::MSGPACK;
+                    else if(format == "json") output_format = DataFormat::JSON;
+                    else if(format == "columns") output_columns = true;
+                    else {
+                        std::cerr << "Unknown output format <" << optarg << ">: json, cbor, msgpack or columns" << std::endl;
+                        std::exit(EXIT_FAILURE);
+                    }
+                    break;
+                }
+            case 't':
+                threads = Threads(argv[0], optarg);
+                break;
+            case 'a':
+                pinned = true;
+                break;
             case 'l':
                 log_level = optarg;
                 std::transform(log_level.begin(), log_level.end(), log_level.begin(), ::tolower);
                 break;
             default:
-                std::cerr << "Usage: " << argv[0] << " -c catalog_path -l log_level -p service_port -d input_data" << std::endl;
+                Usage(argv[0]);
                 std::exit(EXIT_FAILURE);
         }
     }
@@ -141,13 +728,36 @@ int main(int argc, char* argv[]) {
 
     // Start the catalog watcher thread
     FileWatcher watcher(catalog_path);
+    // Workers of the batch conversions
+    ThreadPool pool(threads, pinned);
 
-    if(input_data.empty()){
+    if(not stream_type.empty()){
+        Logger::getInstance().setOutput(Logger::Output::FILE);
+        Logger::getInstance().log("Working catalog path: " + catalog_path, Logger::Level::INFO);
+        watcher.loadCatalog();
+        try{
+            return DecodeStream(stream_type, fields, filters, output_format, output_columns, pool);
+        } catch (const std::exception& e) {
+            Logger::getInstance().log("Stream decoding stopped: " + std::string(e.what()), Logger::Level::CRITICAL);
+            return 5;
+        }
+    } else if(not capture_path.empty()){
+        Logger::getInstance().setOutput(Logger::Output::FILE);
+        Logger::getInstance().log("Working catalog path: " + catalog_path, Logger::Level::INFO);
+        watcher.loadCatalog();
+        Logger::getInstance().log("Analyzing capture: " + capture_path + " with " + std::to_string(pool.size()) + " thread(s)", Logger::Level::INFO);
+        auto start_time = std::chrono::high_resolution_clock::now();
+        int result = DecodeCapture(capture_path, fields, filters, output_format, output_columns, pool);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+        Logger::getInstance().log("Elaboration time: " + std::to_string(duration.count()) + " us", Logger::Level::INFO);
+        return result;
+    } else if(input_data.empty()){
         // Start the application as a server receiving input via gRPC
         Logger::getInstance().log("Application log level: " + log_level, Logger::Level::INFO);
         Logger::getInstance().log("Working catalog path: " + catalog_path, Logger::Level::INFO);
         watcher.StartWatching();
-        RunServer(service_port);
+        RunServer(service_port, pool);
         watcher.StopWatching();
     } else {
         // Just analyze the input data string
@@ -169,12 +779,18 @@ int main(int argc, char* argv[]) {
         }
         Engine engine;
         auto start_time = std::chrono::high_resolution_clock::now();
-        std::string returnJson = engine.convertToJson(inputMessageBase64, inputType, SchemaCatalog::getInstance().getSchema(inputType));
+        std::shared_ptr<const SchemaProgram> projection = FieldMask(inputType, fields);
+        std::string returnJson = engine.convertToJson(inputMessageBase64, inputType, SchemaCatalog::getInstance().getSchema(inputType),
+                                                      DecodeOptions{projection.get(), nullptr, output_format});
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
         Logger::getInstance().log("Elaboration time: " + std::to_string(duration.count()) + " us", Logger::Level::INFO);
-        Logger::getInstance().log("Converted json: "+returnJson, Logger::Level::INFO);
-        std::cout << returnJson << std::endl;
+        if(output_format == DataFormat::JSON){
+            Logger::getInstance().log("Converted json: "+returnJson, Logger::Level::INFO);
+            std::cout << returnJson << std::endl;
+        } else {
+            std::cout << returnJson << std::flush;
+        }
     }
 
     return 0;
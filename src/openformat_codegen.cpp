@@ -0,0 +1,42 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "Codegen.h"
+#include "Logger.h"
+#include "SchemaCatalog.h"
+
+// Usage: openformat-codegen <catalog schema.json> <output header>
+// The schema takes the name of the file, as when the catalog is loaded.
+int main(int argc, char* argv[]) {
+    if(argc != 3){
+        std::cerr << "Usage: " << argv[0] << " <schema.json> <output.h>" << std::endl;
+        return 1;
+    }
+    Logger::getInstance().setLevel(Logger::Level::WARNING);
+    std::filesystem::path input(argv[1]);
+    std::ifstream file(input);
+    if(not file){
+        std::cerr << "Unable to read <" << argv[1] << ">" << std::endl;
+        return 1;
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+
+    try {
+        std::string name = input.stem().string();
+        SchemaCatalog::getInstance().addConfiguration(content.str(), name);
+        std::string code = Codegen::generate(*SchemaCatalog::getInstance().getSchema(name));
+        std::ofstream output(argv[2]);
+        output << code;
+        if(not output){
+            std::cerr << "Unable to write <" << argv[2] << ">" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << argv[1] << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
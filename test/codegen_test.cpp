@@ -0,0 +1,100 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <functional>
+
+#include "Base64.h"
+#include "Engine.h"
+#include "can.h"
+
+// Checks the code generated for catalog/can.json against the interpreter:
+// every message, valid or not, must give the same JSON (or the same error)
+// whether decoded by the generated code or by the interpreter, and the same
+// bits when encoded back.
+//
+// USAGE: codegen_test <path to catalog/can.json> [messages]
+
+static std::string run(const std::function<std::string()>& conversion){
+    try {
+        return conversion();
+    } catch (const std::exception& e) {
+        return std::string("exception: ") + e.what();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <can.json> [messages]" << std::endl;
+        return 1;
+    }
+    size_t messages = argc > 2 ? std::stoul(argv[2]) : 20000;
+    Logger::getInstance().setLevel(Logger::Level::CRITICAL);
+
+    std::ifstream file(argv[1]);
+    std::stringstream content;
+    content << file.rdbuf();
+    SchemaCatalog::getInstance().addConfiguration(content.str(), "can");
+    const Schema* generated = SchemaCatalog::getInstance().getSchema("can");
+    if(generated == nullptr || generated->generated == nullptr){
+        std::cerr << "Generated code not attached to the schema <can>: regenerate it from " << argv[1] << std::endl;
+        return 1;
+    }
+    Schema interpreted = *generated;
+    interpreted.generated = nullptr;
+
+    // The two frames of the README, then random frames of any length
+    std::vector<std::vector<unsigned char>> inputs = {
+        {0x01, 0x40, 0x40, 0x20, 0x68, 0x60, 0x2f, 0xf0},
+        {0x00, 0x1c, 0x00, 0x01, 0x85, 0xff, 0x54, 0x00, 0x33, 0xff, 0x80},
+    };
+    std::mt19937 random(42);
+    while(inputs.size() < messages){
+        std::vector<unsigned char> bytes(1 + random() % 16);
+        for(auto& byte : bytes){
+            byte = static_cast<unsigned char>(random());
+        }
+        inputs.push_back(bytes);
+    }
+
+    size_t failures = 0;
+    size_t fast = 0;
+    JsonWriter writer;
+    for(const auto& bytes : inputs){
+        size_t bits = bytes.size() * 8 - random() % 8;
+        writer.clear();
+        if(generated->generated->decode(bytes.data(), bits, bytes.size(), writer)){
+            fast++;
+        }
+        std::string expected = run([&]{ Engine engine; return engine.convertToJson(bytes.data(), bits, "can", &interpreted); });
+        std::string actual = run([&]{ Engine engine; return engine.convertToJson(bytes.data(), bits, "can", generated); });
+        if(expected != actual){
+            std::cerr << "Decode mismatch on " << bits << " bit(s):" << std::endl << "  interpreter: " << expected << std::endl
+                      << "  generated:   " << actual << std::endl;
+            failures++;
+            continue;
+        }
+        if(expected.rfind("exception: ", 0) == 0){
+            continue;
+        }
+        const std::string decoded = expected;
+        auto encode = [&](const Schema* schema){
+            Engine engine;
+            auto result = engine.convertToBytes(decoded, schema);
+            return std::to_string(result.second) + " " + Base64::encode(reinterpret_cast<const unsigned char*>(result.first.data()), result.first.size());
+        };
+        expected = run([&]{ return encode(&interpreted); });
+        actual = run([&]{ return encode(generated); });
+        if(expected != actual){
+            std::cerr << "Encode mismatch:" << std::endl << "  interpreter: " << expected << std::endl
+                      << "  generated:   " << actual << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << inputs.size() << " message(s), " << fast << " decoded by the generated code, "
+              << failures << " mismatch(es)" << std::endl;
+    return failures == 0 && fast > 0 ? 0 : 1;
+}
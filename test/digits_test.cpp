@@ -0,0 +1,134 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Digits.h"
+
+// Checks each kernel of Digits this CPU runs against values written by
+// hand, for every count of digits: 0, the largest value of the count, a
+// value that does not fit and a wrong digit at each position, then random
+// values, whose results must be the same with every kernel.
+//
+// USAGE: digits_test
+
+static size_t failures = 0;
+
+static void check(bool ok, const std::string& what){
+    if(not ok){
+        if(failures < 20){
+            std::cerr << "Failed: " << what << std::endl;
+        }
+        failures++;
+    }
+}
+
+// 'value' on 'count' ASCII digits, padded with zeros
+static std::string ascii(uint64_t value, size_t count){
+    std::string digits = std::to_string(value);
+    return std::string(count - digits.size(), '0') + digits;
+}
+
+// The same digits in BCD, the low nibble of the last byte 0 for odd counts
+static std::vector<unsigned char> bcd(const std::string& digits){
+    std::vector<unsigned char> bytes((digits.size() + 1) / 2, 0);
+    for(size_t i = 0; i < digits.size(); i++){
+        bytes[i / 2] |= static_cast<unsigned char>((digits[i] - '0') << (i % 2 ? 0 : 4));
+    }
+    return bytes;
+}
+
+// Conversions of 'value' on 'count' digits both ways, in ASCII and BCD
+static std::string convert(uint64_t value, size_t count){
+    std::string label = Digits::implementation() + std::string(" ") + std::to_string(value) + " on " + std::to_string(count) + " digit(s)";
+    std::string digits = ascii(value, count);
+    std::vector<unsigned char> nibbles = bcd(digits);
+
+    char text[Digits::maxDigits + 1] = {};
+    check(Digits::formatAscii(value, text, count) && std::string(text, count) == digits, "formatAscii " + label);
+    uint64_t parsed = 0;
+    check(Digits::parseAscii(digits.data(), count, parsed) && parsed == value, "parseAscii " + label);
+
+    // A guard byte after the digits must be left as it is
+    std::vector<unsigned char> packed(nibbles.size() + 1, 0xaa);
+    check(Digits::formatBcd(value, packed.data(), count) && std::equal(nibbles.begin(), nibbles.end(), packed.begin()) &&
+          packed.back() == 0xaa, "formatBcd " + label);
+    parsed = 0;
+    check(Digits::parseBcd(nibbles.data(), count, parsed) && parsed == value, "parseBcd " + label);
+    if(count % 2){
+        // The nibble after the last digit is not read
+        nibbles.back() |= 0x0f;
+        check(Digits::parseBcd(nibbles.data(), count, parsed) && parsed == value, "parseBcd with a trailing nibble " + label);
+    }
+    return digits + " " + std::string(text, count) + " " + std::to_string(parsed);
+}
+
+static void checkKernel(){
+    uint64_t power = 1;
+    for(size_t count = 1; count <= Digits::maxDigits; count++){
+        uint64_t largest = power * 10 - 1;
+        std::string label = Digits::implementation() + std::string(" on ") + std::to_string(count) + " digit(s)";
+        convert(0, count);
+        convert(largest, count);
+
+        // The first value that needs one more digit
+        char text[Digits::maxDigits + 1];
+        unsigned char packed[Digits::maxDigits];
+        if(count < Digits::maxDigits){
+            check(not Digits::formatAscii(largest + 1, text, count), "formatAscii of a value too large " + label);
+            check(not Digits::formatBcd(largest + 1, packed, count), "formatBcd of a value too large " + label);
+        }
+
+        // A wrong digit at each position, just outside '0'..'9' or a nibble above 9
+        std::string digits = ascii(largest, count);
+        for(size_t position = 0; position < count; position++){
+            uint64_t parsed;
+            for(char wrong : {'/', ':', ' ', '\xb9'}){
+                std::string invalid = digits;
+                invalid[position] = wrong;
+                check(not Digits::parseAscii(invalid.data(), count, parsed), "parseAscii of a wrong digit at " + std::to_string(position) + " " + label);
+            }
+            for(unsigned char nibble = 10; nibble < 16; nibble++){
+                std::vector<unsigned char> invalid = bcd(digits);
+                unsigned char& byte = invalid[position / 2];
+                byte = position % 2 ? static_cast<unsigned char>((byte & 0xf0) | nibble) : static_cast<unsigned char>((byte & 0x0f) | (nibble << 4));
+                check(not Digits::parseBcd(invalid.data(), count, parsed), "parseBcd of a wrong digit at " + std::to_string(position) + " " + label);
+            }
+        }
+        power *= 10;
+    }
+    uint64_t parsed;
+    check(not Digits::parseAscii("1", 0, parsed) && not Digits::parseAscii("00000000000000000001", 20, parsed),
+          std::string("parseAscii of 0 or 20 digits ") + Digits::implementation());
+}
+
+int main() {
+    std::vector<const char*> kernels;
+    for(const char* name : {"scalar", "sse4.1"}){
+        if(Digits::select(name)){
+            kernels.push_back(name);
+            checkKernel();
+        } else {
+            std::cout << "Kernel <" << name << "> not run by this CPU" << std::endl;
+        }
+    }
+
+    // Random values of random counts, converted by each kernel in turn
+    std::mt19937_64 random(42);
+    for(int i = 0; i < 100000; i++){
+        size_t count = 1 + random() % Digits::maxDigits;
+        uint64_t limit = 1;
+        for(size_t j = 0; j < count; j++){ limit *= 10; }
+        uint64_t value = random() % limit;
+        std::string expected;
+        for(const char* name : kernels){
+            Digits::select(name);
+            std::string actual = convert(value, count);
+            check(expected.empty() || actual == expected, std::string("kernels disagree on ") + std::to_string(value));
+            expected = actual;
+        }
+    }
+
+    std::cout << kernels.size() << " kernel(s), " << failures << " failure(s)" << std::endl;
+    return failures == 0 && not kernels.empty() ? 0 : 1;
+}
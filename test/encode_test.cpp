@@ -0,0 +1,68 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Engine.h"
+
+// Encodes FIX messages whose documents do not hold only the fields of
+// catalog/fix.json, or not in its order: an array of unknown length must end
+// where its items end, whatever else the document holds.
+//
+// USAGE: encode_test <path to catalog/fix.json>
+
+struct Case {
+    const char* name;
+    std::string document;
+    DataFormat format;
+};
+
+int main(int argc, char* argv[]) {
+    if(argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <fix.json>" << std::endl;
+        return 1;
+    }
+    Logger::getInstance().setLevel(Logger::Level::CRITICAL);
+
+    std::ifstream file(argv[1]);
+    std::stringstream content;
+    content << file.rdbuf();
+    SchemaCatalog::getInstance().addConfiguration(content.str(), "fix");
+    const Schema* schema = SchemaCatalog::getInstance().getSchema("fix");
+    if(schema == nullptr){
+        std::cerr << "Schema <fix> not loaded from " << argv[1] << std::endl;
+        return 1;
+    }
+
+    const std::string expected = "8=FIX.4.2\x01" "35=A\x01";
+    const std::string extra = R"([{"tag":8,"value":"FIX.4.2"},{"tag":35,"value":"A","extra":1}])";
+    std::vector<uint8_t> cbor = nlohmann::json::to_cbor(nlohmann::json::parse(extra));
+    std::vector<Case> cases = {
+        {"in order", R"([{"tag":8,"value":"FIX.4.2"},{"tag":35,"value":"A"}])", DataFormat::JSON},
+        {"trailing key in the last item", extra, DataFormat::JSON},
+        {"trailing key in CBOR", std::string(cbor.begin(), cbor.end()), DataFormat::CBOR},
+        {"trailing top-level key", R"({"0":{"tag":8,"value":"FIX.4.2"},"1":{"tag":35,"value":"A"},"extra":1})", DataFormat::JSON},
+        {"leading top-level key", R"({"extra":[1,2],"0":{"tag":8,"value":"FIX.4.2"},"1":{"tag":35,"value":"A"}})", DataFormat::JSON},
+        {"keys out of order", R"([{"value":"FIX.4.2","tag":8},{"extra":{},"value":"A","tag":35}])", DataFormat::JSON},
+        {"items out of order", R"({"1":{"tag":35,"value":"A"},"0":{"tag":8,"value":"FIX.4.2"}})", DataFormat::JSON},
+    };
+
+    size_t failures = 0;
+    for(const auto& test : cases){
+        std::string actual;
+        try {
+            Engine engine;
+            actual = engine.convertToBytes(test.document, schema, test.format).first;
+        } catch (const std::exception& e) {
+            actual = std::string("exception: ") + e.what();
+        }
+        if(actual != expected){
+            std::cerr << "Mismatch on " << test.name << ": " << actual << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << cases.size() << " document(s), " << failures << " mismatch(es)" << std::endl;
+    return failures == 0 ? 0 : 1;
+}